@@ -0,0 +1,6 @@
+include $(config_dir)rel.mk
+
+this_cxxflags += -fsanitize=thread
+this_ldflags += -fsanitize=thread
+
+this_lint_cmd = $(prorab_lint_cmd_clang_tidy)
@@ -20,6 +20,13 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 /* ================ LICENSE END ================ */
 
 #include "application.hpp"
+#include "trace.hpp"
+#include "startup.hpp"
+#include "res_pack.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
 
 #include <utki/debug.hpp>
 #include <utki/config.hpp>
@@ -31,13 +38,202 @@ using namespace mordavokne;
 
 application::T_Instance application::instance;
 
+application::~application()noexcept{
+	// deliver the frames which are still being read back, while the graphics context still exists
+	try{
+		this->collect_read_frames(true);
+	}catch(std::exception& e){
+		LOG([&](auto&o){o << "delivering read back frames failed: " << e.what() << std::endl;})
+	}
+}
+
+namespace{
+r4::rectangle<int> unite(const r4::rectangle<int>& a, const r4::rectangle<int>& b){
+	using std::min;
+	using std::max;
+
+	if(!a.d.is_positive()){
+		return b;
+	}
+	if(!b.d.is_positive()){
+		return a;
+	}
+
+	int x1 = min(a.p.x(), b.p.x());
+	int y1 = min(a.p.y(), b.p.y());
+	int x2 = max(a.p.x() + a.d.x(), b.p.x() + b.d.x());
+	int y2 = max(a.p.y() + a.d.y(), b.p.y() + b.d.y());
+
+	return r4::rectangle<int>(x1, y1, x2 - x1, y2 - y1);
+}
+
+r4::rectangle<int> intersect(const r4::rectangle<int>& a, const r4::rectangle<int>& b){
+	using std::min;
+	using std::max;
+
+	int x1 = max(a.p.x(), b.p.x());
+	int y1 = max(a.p.y(), b.p.y());
+	int x2 = min(a.p.x() + a.d.x(), b.p.x() + b.d.x());
+	int y2 = min(a.p.y() + a.d.y(), b.p.y() + b.d.y());
+
+	return r4::rectangle<int>(x1, y1, max(x2 - x1, 0), max(y2 - y1, 0));
+}
+}
+
+void application::invalidate(const morda::rectangle& rect)noexcept{
+	if(!rect.d.is_positive()){
+		return;
+	}
+
+	if(!this->frame_dirty){
+		this->frame_dirty = true;
+		this->frame_damage_is_full = false;
+		this->dirty_rect = rect;
+		return;
+	}
+
+	if(this->frame_damage_is_full){
+		return;
+	}
+
+	using std::min;
+	using std::max;
+
+	morda::vector2 p1(
+			min(this->dirty_rect.p.x(), rect.p.x()),
+			min(this->dirty_rect.p.y(), rect.p.y())
+		);
+	morda::vector2 p2(
+			max(this->dirty_rect.p.x() + this->dirty_rect.d.x(), rect.p.x() + rect.d.x()),
+			max(this->dirty_rect.p.y() + this->dirty_rect.d.y(), rect.p.y() + rect.d.y())
+		);
+
+	this->dirty_rect = morda::rectangle(p1, p2 - p1);
+}
+
 void application::render(){
-	// TODO: render only if needed?
-	this->gui.context->renderer->clear_framebuffer();
+	// Keep the most recent read back frames in flight only if this frame is going to be read back as well,
+	// otherwise there might be no more frames to deliver them with.
+	this->collect_read_frames(
+			(this->render_on_demand && !this->frame_dirty) || (!this->frame_sink && this->capture_callbacks.empty())
+		);
+
+	if(this->render_on_demand && !this->frame_dirty){
+		++this->frame_stats.num_skipped;
+		this->frame_prof.mark(frame_profiler::phase::render);
+		return;
+	}
+
+	r4::rectangle<int> viewport(
+			int(this->curWinRect.p.x()),
+			int(this->curWinRect.p.y()),
+			int(this->curWinRect.d.x()),
+			int(this->curWinRect.d.y())
+		);
+
+	r4::rectangle<int> damage = viewport;
+
+	// HUD is redrawn every frame, so partial redraw is not possible when it is shown
+	if(this->render_on_demand && !this->frame_damage_is_full && !this->hud_visible){
+		using std::floor;
+		using std::ceil;
+
+		// convert dirty rectangle from window coordinates (y goes down) to viewport pixel coordinates (y goes up)
+		int x1 = int(floor(this->dirty_rect.p.x()));
+		int x2 = int(ceil(this->dirty_rect.p.x() + this->dirty_rect.d.x()));
+		int y1 = int(floor(this->curWinRect.d.y() - this->dirty_rect.p.y() - this->dirty_rect.d.y()));
+		int y2 = int(ceil(this->curWinRect.d.y() - this->dirty_rect.p.y()));
+
+		damage = intersect(
+				r4::rectangle<int>(viewport.p.x() + x1, viewport.p.y() + y1, x2 - x1, y2 - y1),
+				viewport
+			);
+	}
 
-	this->gui.render(this->gui.context->renderer->initial_matrix);
+	// reset the flag before rendering, so that anything invalidated during rendering will cause next frame to be rendered
+	this->frame_dirty = false;
+	this->frame_damage_is_full = false;
+
+	if(!damage.d.is_positive()){
+		// invalidated region is outside of the window
+		++this->frame_stats.num_skipped;
+		this->frame_prof.mark(frame_profiler::phase::render);
+		return;
+	}
+
+	// The back buffer contains the frame which was rendered 'age' frames ago, so, besides the damage of the
+	// current frame, the regions damaged by the frames rendered since then have to be redrawn as well.
+	r4::rectangle<int> redraw_rect = damage;
+	if(damage != viewport){
+		unsigned age = this->get_buffer_age();
+		if(age == 0 || age > this->damage_history.size() + 1){
+			// back buffer contents are undefined, or too old
+			redraw_rect = viewport;
+		}else{
+			for(unsigned i = 0; i != age - 1; ++i){
+				redraw_rect = unite(redraw_rect, this->damage_history[i]);
+			}
+			redraw_rect = intersect(redraw_rect, viewport);
+		}
+	}
+
+	std::copy_backward(this->damage_history.begin(), std::prev(this->damage_history.end()), this->damage_history.end());
+	this->damage_history.front() = damage;
+
+	this->frame_is_partial = damage != viewport;
+	this->frame_damage = damage;
+
+	auto& r = *this->gui.context->renderer;
+
+	bool partial_redraw = redraw_rect != viewport;
+	if(partial_redraw){
+		r.set_scissor_enabled(true);
+		r.set_scissor(redraw_rect);
+	}
+
+	this->begin_gpu_timing();
+
+	r.clear_framebuffer();
+
+	this->gui.render(r.initial_matrix);
+
+	this->end_gpu_timing();
+
+	if(partial_redraw){
+		r.set_scissor_enabled(false);
+	}
+
+	if(this->hud_visible){
+		this->render_hud();
+	}
+
+	if(this->frame_sink || !this->capture_callbacks.empty()){
+		this->read_frame();
+	}
+
+	this->frame_prof.mark(frame_profiler::phase::render);
 
 	this->swap_frame_buffers();
+
+	if(this->has_pending_input){
+		this->input_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - this->pending_input_time
+			));
+		this->has_pending_input = false;
+	}
+
+	if(this->input_recorder_pimpl){
+		this->record_frame();
+	}
+
+	this->frame_prof.mark(frame_profiler::phase::swap);
+	this->frame_prof.end_frame();
+
+	++this->frame_stats.num_rendered;
+
+	if(this->frame_stats.num_rendered == 1){
+		startup::mark_first_frame();
+	}
 }
 
 void application::update_window_rect(const morda::rectangle& rect){
@@ -45,21 +241,51 @@ void application::update_window_rect(const morda::rectangle& rect){
 		return;
 	}
 
+	trace::scope trace_scope("update_window_rect");
+
 	this->curWinRect = rect;
 
+	this->invalidate();
+
 	LOG([&](auto&o){o << "application::update_window_rect(): this->curWinRect = " << this->curWinRect << std::endl;})
-	this->gui.context->renderer->set_viewport(r4::rectangle<int>(
+	r4::rectangle<int> viewport(
 			int(this->curWinRect.p.x()),
 			int(this->curWinRect.p.y()),
 			int(this->curWinRect.d.x()),
 			int(this->curWinRect.d.y())
-		));
+		);
+	this->gui.context->renderer->set_viewport(viewport);
+
+	// contents of all back buffers are to be fully redrawn after resize
+	this->damage_history.fill(viewport);
 
 	this->gui.set_viewport(this->curWinRect.d);
 }
 
+void application::mount_res_pack(const std::string& file_name){
+	this->res_pack_v = std::make_shared<const res_pack>(file_name);
+}
+
 #if M_OS_NAME != M_OS_NAME_ANDROID && M_OS_NAME != M_OS_NAME_IOS
+namespace{
+const std::shared_ptr<const res_pack>& get_env_res_pack(){
+	// opened once on first use, the pack stays mapped till the program exit
+	static const std::shared_ptr<const res_pack> pack = []() -> std::shared_ptr<const res_pack>{
+		const char* file_name = getenv("MORDAVOKNE_RES_PACK");
+		if(!file_name || *file_name == '\0'){
+			return nullptr;
+		}
+		return std::make_shared<const res_pack>(file_name);
+	}();
+	return pack;
+}
+}
+
 std::unique_ptr<papki::file> application::get_res_file(const std::string& path)const{
+	const auto& pack = this->res_pack_v ? this->res_pack_v : get_env_res_pack();
+	if(pack){
+		return res_pack::make_file(pack, path);
+	}
 	return std::make_unique<papki::fs_file>(path);
 }
 
@@ -101,6 +327,16 @@ morda::real application::get_pixels_per_dp(r4::vector2<unsigned> resolution, r4:
 }
 
 void application::handle_key_event(bool is_down, morda::key key_code){
+	this->note_input_handling();
+
+	if(key_code == this->hud_hotkey && key_code != morda::key::unknown){
+		if(is_down){
+			this->set_hud_visible(!this->hud_visible);
+		}
+		return;
+	}
+
+	this->invalidate();
 	this->gui.send_key(is_down, key_code);
 }
 
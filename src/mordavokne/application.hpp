@@ -22,6 +22,10 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <memory>
+#include <array>
+#include <vector>
+#include <functional>
+#include <exception>
 
 #include <utki/config.hpp>
 #include <utki/singleton.hpp>
@@ -37,9 +41,16 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <morda/util/key.hpp>
 
 #include "config.hpp"
+#include "frame_profiler.hpp"
+#include "latency_histogram.hpp"
 
 namespace mordavokne{
 
+struct input_event;
+class shared_gl_context;
+class res_pack;
+class res_watcher;
+
 /**
  * @brief Desired window parameters.
  */
@@ -91,6 +102,76 @@ struct window_params{
 #endif
 	;
 
+	/**
+	 * @brief Frame presentation mode.
+	 */
+	enum class present_mode{
+		/**
+		 * @brief Present frames immediately, no vertical synchronization.
+		 */
+		immediate,
+
+		/**
+		 * @brief Synchronize frame presentation with vertical blank.
+		 */
+		vsync,
+
+		/**
+		 * @brief Adaptive vertical synchronization.
+		 * Frames are synchronized with vertical blank unless the frame is late,
+		 * in which case it is presented immediately.
+		 * If adaptive vsync is not supported by the platform, then it falls back to vsync.
+		 */
+		adaptive,
+
+		/**
+		 * @brief Present frames immediately, but not more often than max_fps times per second.
+		 */
+		capped
+	};
+
+	present_mode present_mode_request =
+#if M_OS_NAME == M_OS_NAME_ANDROID || M_OS_NAME == M_OS_NAME_IOS
+		present_mode::vsync
+#else
+		present_mode::immediate
+#endif
+	;
+
+	/**
+	 * @brief Maximum number of frames per second for capped presentation mode.
+	 */
+	unsigned max_fps = 60;
+
+	/**
+	 * @brief Parallel startup mode.
+	 * If true, the startup steps which do not depend on the graphics context, like storage directory
+	 * initialization and input method setup, are done on helper threads while the graphics context
+	 * is being created. On X11 this requires Xlib to be initialized for multithreading, which adds
+	 * some locking overhead to every Xlib call, so it is off by default.
+	 * Currently only affects the X11 backends. See startup.hpp for startup time instrumentation.
+	 */
+	bool parallel_startup = false;
+
+	/**
+	 * @brief Shader program binary cache.
+	 * If true, the renderer's shader programs are stored as binaries in the storage directory
+	 * after they are first linked, and loaded from there on subsequent startups, so that the programs
+	 * are not linked each time. The cache is kept separately for each GL driver vendor, renderer and version.
+	 * Requires OpenGL 4.1 or GL_ARB_get_program_binary, otherwise has no effect.
+	 * Currently only affects the X11 backend with desktop OpenGL, off by default.
+	 */
+	bool program_binary_cache = false;
+
+	/**
+	 * @brief Create graphics context for background loading.
+	 * If true, a second graphics context, which shares objects with the main one, is created for the
+	 * background loader thread, see application::load_async(). On X11 this requires Xlib to be
+	 * initialized for multithreading, which adds some locking overhead to every Xlib call, so it is off by default.
+	 * Currently only supported by the Linux and Android backends.
+	 */
+	bool background_loader = false;
+
 	window_params(r4::vector2<unsigned> dims) :
 			dims(dims)
 	{}
@@ -127,11 +208,37 @@ public:
 	 * @brief Create file interface into resources storage.
 	 * This function creates a morda's standard file interface to read application's
 	 * resources.
+	 * On desktop platforms, if a resource pack is mounted, see mount_res_pack(), then the files are read from the pack,
+	 * the files which are not in the pack are read from the filesystem.
 	 * @param path - file path to initialize the file interface with.
 	 * @return Instance of the file interface into the resources storage.
 	 */
 	std::unique_ptr<papki::file> get_res_file(const std::string& path = std::string())const;
 
+private:
+	std::shared_ptr<const res_pack> res_pack_v;
+
+public:
+	/**
+	 * @brief Mount resource pack.
+	 * After mounting, the resource files are served by get_res_file() from the memory-mapped pack, see res_pack.
+	 * If a pack is already mounted, it is replaced. The file interfaces created before keep using the pack they were created with.
+	 * Note, that if the MORDAVOKNE_RES_PACK environment variable is set to a resource pack file name, that pack is used
+	 * by get_res_file() while no other pack is mounted, this way the pack is in use already in the application's constructor.
+	 * Resource packs are only supported on desktop platforms, on Android and iOS the mounted pack is not used.
+	 * @param file_name - resource pack file name.
+	 */
+	void mount_res_pack(const std::string& file_name);
+
+	/**
+	 * @brief Unmount resource pack.
+	 * After unmounting, get_res_file() serves the files from the filesystem, or from the pack given by
+	 * MORDAVOKNE_RES_PACK environment variable, if it is set.
+	 */
+	void unmount_res_pack()noexcept{
+		this->res_pack_v.reset();
+	}
+
 public:
 	/**
 	 * @brief Storage directory path.
@@ -151,7 +258,200 @@ public:
 		return this->curWinRect.d;
 	}
 
+public:
+	/**
+	 * @brief Frame rendering statistics.
+	 */
+	struct frame_statistics{
+		/**
+		 * @brief Number of frames which were actually rendered and presented.
+		 */
+		uint64_t num_rendered = 0;
+
+		/**
+		 * @brief Number of render requests which were skipped.
+		 * In render on demand mode the render request is skipped if nothing has been invalidated
+		 * since the last rendered frame.
+		 */
+		uint64_t num_skipped = 0;
+	};
+
+private:
+	bool render_on_demand = false;
+	bool frame_dirty = true;
+
+	// Invalidated region in window coordinates (y goes down), only valid if frame_dirty is true.
+	// If frame_damage_is_full is true then the whole window is invalidated.
+	bool frame_damage_is_full = true;
+	morda::rectangle dirty_rect;
+
+	// Damaged regions of the previously rendered frames in viewport pixel coordinates (y goes up),
+	// most recent first. Needed for partial redraw of the back buffers of older age.
+	std::array<r4::rectangle<int>, 4> damage_history;
+
+	// damaged region of the frame being presented, in viewport pixel coordinates (y goes up)
+	bool frame_is_partial = false;
+	r4::rectangle<int> frame_damage;
+
+	// Age of the back buffer in frames, as defined by EGL_EXT_buffer_age/GLX_EXT_buffer_age extensions.
+	// Returns 0 if the age is unknown or undefined.
+	unsigned get_buffer_age();
+
+	frame_statistics frame_stats;
+
+public:
+	/**
+	 * @brief Enable/disable render on demand mode.
+	 * In render on demand mode the main loop only renders and presents a frame when something
+	 * has invalidated the window contents since the previous frame, i.e. an input event was delivered to the GUI,
+	 * a UI message was handled, an updateable was updated or the window was resized or exposed.
+	 * Otherwise, the rendering and the buffer swap are skipped.
+	 * By default, the render on demand mode is disabled and the frame is rendered on every main loop cycle.
+	 * @param enable - whether to enable (true) or disable (false) the render on demand mode.
+	 */
+	void set_render_on_demand(bool enable)noexcept{
+		this->render_on_demand = enable;
+		this->invalidate();
+	}
+
+	/**
+	 * @brief Check if render on demand mode is enabled.
+	 * @return true if render on demand mode is enabled.
+	 * @return false otherwise.
+	 */
+	bool is_render_on_demand()const noexcept{
+		return this->render_on_demand;
+	}
+
+	/**
+	 * @brief Invalidate window contents.
+	 * Request the window contents to be rendered on the next main loop cycle.
+	 * This is only needed in render on demand mode in case the GUI is changed by something
+	 * which is not tracked by the main loop itself.
+	 */
+	void invalidate()noexcept{
+		this->frame_dirty = true;
+		this->frame_damage_is_full = true;
+	}
+
+	/**
+	 * @brief Invalidate part of the window contents.
+	 * Request the given region of the window to be redrawn on the next main loop cycle.
+	 * In render on demand mode, if only a part of the window is invalidated and the platform supports
+	 * querying the back buffer age, then only the damaged region is redrawn and,
+	 * where supported, only the damaged region is presented.
+	 * @param rect - region to invalidate, in window coordinates, y axis goes down.
+	 */
+	void invalidate(const morda::rectangle& rect)noexcept;
+
+	/**
+	 * @brief Get frame rendering statistics.
+	 * @return Rendered and skipped frame counters.
+	 */
+	const frame_statistics& get_frame_statistics()const noexcept{
+		return this->frame_stats;
+	}
+
+private:
+	mordavokne::frame_profiler frame_prof;
+
+	friend void mark_frame_phase(application& app, frame_profiler::phase p);
+	friend void count_ui_message(application& app);
+
+	std::unique_ptr<utki::destructable> gpu_timer_pimpl;
+
+	// wrap the frame rendering commands with GPU timer query, if GPU timing is enabled
+	void begin_gpu_timing();
+	void end_gpu_timing();
+
+public:
+	/**
+	 * @brief Get frame profiler.
+	 * The profiler measures durations of the main loop phases for each rendered frame.
+	 * Profiling is disabled by default, enable it with frame_profiler::set_enabled().
+	 * @return Frame profiler.
+	 */
+	mordavokne::frame_profiler& get_frame_profiler()noexcept{
+		return this->frame_prof;
+	}
+
+	/**
+	 * @brief Captured frame image.
+	 */
+	struct frame_image{
+		/**
+		 * @brief Image dimensions in pixels.
+		 */
+		r4::vector2<unsigned> dims;
+
+		/**
+		 * @brief Image pixels.
+		 * RGBA, 4 bytes per pixel, rows go from top to bottom.
+		 */
+		std::vector<uint8_t> pixels;
+
+		/**
+		 * @brief Number of the captured frame.
+		 * Zero-based index of the frame among all rendered frames, see frame_statistics::num_rendered.
+		 */
+		uint64_t frame_number;
+	};
+
+	/**
+	 * @brief Frame capture callback.
+	 */
+	typedef std::function<void(frame_image&& image)> capture_callback_type;
+
+	/**
+	 * @brief Frame sink.
+	 */
+	typedef std::function<void(const frame_image& image)> frame_sink_type;
+
 private:
+	std::unique_ptr<utki::destructable> frame_reader_pimpl;
+
+	std::vector<capture_callback_type> capture_callbacks;
+	frame_sink_type frame_sink;
+
+	// In render on demand mode, set when captured frames are being read back and one more main loop cycle
+	// is needed to deliver them, without rendering a new frame.
+	bool readback_pending = false;
+
+	friend bool is_readback_pending(const application& app);
+
+	void read_frame();
+	void collect_read_frames(bool all);
+
+public:
+	/**
+	 * @brief Capture next rendered frame.
+	 * The frame contents are read back asynchronously, where the platform supports it, so that
+	 * the rendering pipeline is not stalled. The callback is called from the UI thread a few frames later,
+	 * or on the next main loop cycle if there are no more frames rendered.
+	 * This function invalidates the window contents, so that the frame is rendered also in render on demand mode.
+	 * @param callback - callback to call when the captured frame is ready.
+	 */
+	void capture_frame(capture_callback_type&& callback);
+
+	/**
+	 * @brief Set frame sink.
+	 * Frame sink receives every rendered frame. The frames are read back in the same way as with capture_frame().
+	 * See make_frame_file_sink() for a sink which writes the frames to files.
+	 * In render on demand mode the last read back frames are delivered on the next main loop cycle.
+	 * The frames which are still being read back when the application is destroyed are delivered from
+	 * the application destructor, so the sink must not refer to the derived application object.
+	 * @param sink - frame sink, or nullptr to stop capturing frames. Frames which are being read back at
+	 *               the moment of changing the sink are delivered to the old sink before this function returns.
+	 */
+	void set_frame_sink(frame_sink_type&& sink);
+
+private:
+	bool needs_render()const noexcept{
+		return !this->render_on_demand || this->frame_dirty || this->readback_pending;
+	}
+
+	friend bool needs_render(const application& app);
+
 	void render();
 
 	friend void render(application& app);
@@ -160,8 +460,76 @@ private:
 
 	friend void update_window_rect(application& app, const morda::rectangle& rect);
 
+private:
+	bool input_latency_measurement = false;
+
+	// arrival time of the earliest input event which has not been presented yet
+	bool has_pending_input = false;
+	std::chrono::steady_clock::time_point pending_input_time;
+
+	latency_histogram input_latency;
+
+	void note_input_time(std::chrono::steady_clock::time_point time)noexcept{
+		if(!this->input_latency_measurement){
+			return;
+		}
+		if(!this->has_pending_input || time < this->pending_input_time){
+			this->has_pending_input = true;
+			this->pending_input_time = time;
+		}
+	}
+
+	// In case the glue did not note the input event timestamp, the time of handling it is used.
+	void note_input_handling()noexcept{
+		if(!this->input_latency_measurement){
+			return;
+		}
+		this->note_input_time(std::chrono::steady_clock::now());
+	}
+
+	friend void note_input_time(application& app, std::chrono::steady_clock::time_point time);
+
+public:
+	/**
+	 * @brief Enable/disable input-to-photon latency measurement.
+	 * When enabled, the time from input event arrival till the buffer swap of the first frame rendered after
+	 * handling the event is measured and added to the input latency histogram, see get_input_latency().
+	 * If several input events are handled before the frame is rendered, then the earliest one is taken.
+	 * The input event arrival time is taken from the window system's event timestamp where it is known
+	 * to use the same clock as std::chrono::steady_clock (X11, Wayland and Android), otherwise it is
+	 * the time when the event is handled by the main loop.
+	 * Note, that the measured latency ends when the buffer swap completes, it does not include
+	 * the compositor and display latency.
+	 * By default, latency measurement is disabled.
+	 * @param enable - whether to enable (true) or disable (false) latency measurement.
+	 */
+	void set_input_latency_measurement(bool enable)noexcept{
+		this->input_latency_measurement = enable;
+		this->has_pending_input = false;
+	}
+
+	/**
+	 * @brief Check if input-to-photon latency measurement is enabled.
+	 * @return true if latency measurement is enabled.
+	 * @return false otherwise.
+	 */
+	bool is_input_latency_measurement()const noexcept{
+		return this->input_latency_measurement;
+	}
+
+	/**
+	 * @brief Get input-to-photon latency histogram.
+	 * @return Input latency histogram.
+	 */
+	latency_histogram& get_input_latency()noexcept{
+		return this->input_latency;
+	}
+
+private:
 	// pos is in usual window coordinates, y goes down.
 	void handle_mouse_move(const r4::vector2<float>& pos, unsigned id){
+		this->note_input_handling();
+		this->invalidate();
 		this->gui.send_mouse_move(pos, id);
 	}
 
@@ -169,17 +537,76 @@ private:
 
 	// pos is in usual window coordinates, y goes down.
 	void handle_mouse_button(bool isDown, const r4::vector2<float>& pos, morda::mouse_button button, unsigned id){
+		this->note_input_handling();
+		this->invalidate();
 		this->gui.send_mouse_button(isDown, pos, button, id);
 	}
 
 	friend void handle_mouse_button(application& app, bool isDown, const r4::vector2<float>& pos, morda::mouse_button button, unsigned id);
 
 	void handleMouseHover(bool is_hovered, unsigned id){
+		this->note_input_handling();
+		this->invalidate();
 		this->gui.send_mouse_hover(is_hovered, id);
 	}
 
 	friend void handleMouseHover(application& app, bool isHovered, unsigned pointerID);
 
+private:
+	bool motion_coalescing = false;
+	unsigned num_motion_history_requests = 0;
+
+	bool should_coalesce_motion()const noexcept{
+		return this->motion_coalescing && this->num_motion_history_requests == 0;
+	}
+
+	friend bool should_coalesce_motion(const application& app);
+
+public:
+	/**
+	 * @brief Enable/disable mouse motion coalescing.
+	 * When enabled, consecutive mouse motion events of the same pointer which are pending in the window system's
+	 * event queue are collapsed into a single mouse move event with the latest pointer position.
+	 * This saves the GUI from handling dozens of mouse moves per frame coming from high polling rate mice.
+	 * The order of the motion events relative to other input events is preserved.
+	 * Currently, motion coalescing is only implemented for X11.
+	 * By default, motion coalescing is disabled.
+	 * @param enable - whether to enable (true) or disable (false) mouse motion coalescing.
+	 */
+	void set_motion_coalescing(bool enable)noexcept{
+		this->motion_coalescing = enable;
+	}
+
+	/**
+	 * @brief Check if mouse motion coalescing is enabled.
+	 * @return true if motion coalescing is enabled.
+	 * @return false otherwise.
+	 */
+	bool is_motion_coalescing()const noexcept{
+		return this->motion_coalescing;
+	}
+
+	/**
+	 * @brief Request full mouse motion history.
+	 * Widgets which need every intermediate pointer position, e.g. a drawing canvas,
+	 * should call this function to suspend mouse motion coalescing and call release_motion_history()
+	 * when they do not need it anymore. The requests are counted, so motion coalescing is only resumed
+	 * when all the requests are released.
+	 */
+	void request_motion_history()noexcept{
+		++this->num_motion_history_requests;
+	}
+
+	/**
+	 * @brief Release full mouse motion history request.
+	 * Each call to this function must be paired with a preceding call to request_motion_history().
+	 */
+	void release_motion_history()noexcept{
+		if(this->num_motion_history_requests != 0){
+			--this->num_motion_history_requests;
+		}
+	}
+
 protected:
 	/**
 	 * @brief Application constructor.
@@ -190,7 +617,7 @@ protected:
 
 public:
 
-	virtual ~application()noexcept{}
+	virtual ~application()noexcept;
 
 	/**
 	 * @brief Bring up the virtual keyboard.
@@ -211,6 +638,8 @@ private:
 	// The idea with unicode_resolver parameter is that we don't want to calculate the unicode unless it is really needed, thus postpone it
 	// as much as possible.
 	void handle_character_input(const morda::gui::input_string_provider& string_provider, morda::key key_code){
+		this->note_input_handling();
+		this->invalidate();
 		this->gui.send_character_input(string_provider, key_code);
 	}
 
@@ -220,6 +649,169 @@ private:
 
 	friend void handle_key_event(application& app, bool is_down, morda::key key_code);
 
+private:
+	std::unique_ptr<utki::destructable> input_recorder_pimpl;
+	std::shared_ptr<morda::updateable> input_replayer;
+
+	friend void record_input(application& app, input_event&& e);
+
+	void record_frame();
+	void replay_input(const input_event& e);
+
+public:
+	/**
+	 * @brief Start recording input events.
+	 * All input events and window resizes delivered by the window system are recorded to a compact binary log
+	 * together with their timestamps. The ends of rendered frames are recorded as well, so that the events can be
+	 * replayed frame by frame. If recording is already active, it is stopped and a new recording is started.
+	 * @param file_name - name of the input log file to write.
+	 */
+	void start_input_recording(const std::string& file_name);
+
+	/**
+	 * @brief Stop recording input events.
+	 * Writes the rest of the recorded events to the log file and closes it.
+	 */
+	void stop_input_recording();
+
+	/**
+	 * @brief Check if input events are being recorded.
+	 * @return true if input recording is active.
+	 * @return false otherwise.
+	 */
+	bool is_input_recording()const noexcept{
+		return bool(this->input_recorder_pimpl);
+	}
+
+	/**
+	 * @brief Start replaying recorded input events.
+	 * The recorded events are fed to the GUI from the main loop's update phase, same as if they came
+	 * from the window system. Recorded window resizes only change the viewport, the window itself is not resized.
+	 * The replay keeps the main loop running without waiting for events.
+	 * If replay is already active, it is stopped and the new replay is started.
+	 * Note, that when the MORDAVOKNE_REPLAY_INPUT environment variable is set to an input log file name,
+	 * the replay is started right after the application is created, the replay speed is maximal if
+	 * MORDAVOKNE_REPLAY_SPEED is set to "max", and the application quits when the replay is finished.
+	 * Likewise, MORDAVOKNE_RECORD_INPUT environment variable starts recording to the given file.
+	 * @param file_name - name of the input log file to replay.
+	 * @param max_speed - if true, the events are replayed as fast as possible, the events which were handled
+	 *                    before one recorded frame are handled before one replayed frame.
+	 *                    If false, the events are replayed with their original timing.
+	 * @param finished - callback to call when all the events are replayed.
+	 */
+	void start_input_replay(const std::string& file_name, bool max_speed, std::function<void()>&& finished = nullptr);
+
+	/**
+	 * @brief Stop replaying input events.
+	 */
+	void stop_input_replay();
+
+	/**
+	 * @brief Check if input events are being replayed.
+	 * @return true if input replay is active.
+	 * @return false otherwise.
+	 */
+	bool is_input_replaying()const noexcept;
+
+private:
+	std::unique_ptr<utki::destructable> loader_pimpl;
+
+	// returns nullptr if the backend does not support shared contexts or background loader was not requested
+	std::unique_ptr<shared_gl_context> create_shared_gl_context();
+
+public:
+	/**
+	 * @brief Load resources in background.
+	 * Runs the 'load' function on the background loader thread, which has its own graphics context sharing
+	 * objects with the main one, so the function can decode images and create textures, vertex buffers etc.
+	 * via the renderer's factory without blocking the UI thread. Note, that morda's resource loader is not
+	 * thread safe, so it must not be used from the 'load' function.
+	 * When the function returns, the loader waits on a fence till the GPU has completed the uploads, and then
+	 * the 'completed' callback is posted to the UI thread's queue, so the loaded objects can be used from there.
+	 * The functions are executed in the order of the load_async() calls.
+	 * If background loading is not available, see window_params::background_loader, then the 'load' function
+	 * is executed on the UI thread.
+	 * When the application is destroyed, the loads which have not been started yet are discarded.
+	 * @param load - function to execute on the loader thread.
+	 * @param completed - callback to execute on the UI thread after the load has finished.
+	 *                    The exception thrown by the 'load' function, if any, is passed to the callback.
+	 */
+	void load_async(std::function<void()>&& load, std::function<void(std::exception_ptr)>&& completed);
+
+private:
+	std::unique_ptr<utki::destructable> res_watcher_pimpl;
+
+	friend res_watcher* get_res_watcher(application& app);
+
+public:
+	/**
+	 * @brief Watch resource directory for changes.
+	 * Intended for development, to see the changes of GUI layouts, images etc. without restarting the application.
+	 * The directory and all its subdirectories are watched, the 'changed' callback is called from the UI thread
+	 * for each file which has been written, created or moved into the directory.
+	 * The file name passed to the callback is the directory path followed by the file path within the directory,
+	 * so it can be passed to get_res_file() as is.
+	 * Note, that morda's resource loader returns the already loaded resource object while it is referenced,
+	 * so in order to reload a changed resource, all references to it have to be dropped first, e.g. by
+	 * setting the GUI root to nullptr before re-inflating the GUI.
+	 * Watching is only supported on desktop Linux, with X11 and Wayland.
+	 * @param dir - directory to watch, must end with '/'.
+	 * @param changed - callback to call when a file has changed.
+	 * @return true if the directory is being watched.
+	 * @return false if watching is not supported on this platform.
+	 */
+	bool watch_resources(const std::string& dir, std::function<void(const std::string& file_name)>&& changed);
+
+private:
+	bool hud_visible = false;
+	morda::key hud_hotkey = morda::key::unknown;
+
+	// profiler state to restore when the HUD is hidden
+	bool hud_prev_prof_enabled = false;
+	bool hud_prev_gpu_timing = false;
+
+	std::unique_ptr<utki::destructable> hud_pimpl;
+
+	void render_hud();
+
+public:
+	/**
+	 * @brief Show/hide performance HUD.
+	 * Performance HUD is an overlay in the top left corner of the window which shows:
+	 * - frames per second, white digits;
+	 * - GPU rendering time of the last measured frame in milliseconds, cyan digits, if GPU timing is supported;
+	 * - graph of the recent frame times, the bars are green, yellow or red for frames taking less than
+	 *   one, less than two or more than two 60Hz vsync intervals respectively;
+	 * - number of UI queue messages handled during the last frame, orange digits;
+	 * - time of the last gui.update() in milliseconds, violet digits.
+	 *
+	 * The HUD is rendered with a single draw call after the GUI.
+	 * The HUD shows the data of the frame profiler, so showing the HUD enables the profiler and GPU timing,
+	 * hiding the HUD restores their previous state.
+	 * Note, that in render on demand mode the HUD is only updated when a frame is rendered.
+	 * @param visible - whether to show (true) or hide (false) the HUD.
+	 */
+	void set_hud_visible(bool visible);
+
+	/**
+	 * @brief Check if performance HUD is shown.
+	 * @return true if the HUD is shown.
+	 * @return false otherwise.
+	 */
+	bool is_hud_visible()const noexcept{
+		return this->hud_visible;
+	}
+
+	/**
+	 * @brief Set key which toggles performance HUD.
+	 * The hotkey press and release events are not delivered to the GUI.
+	 * By default, there is no hotkey, so that no key events are taken away from the GUI.
+	 * @param key - hotkey, e.g. morda::key::f12, morda::key::unknown disables the hotkey.
+	 */
+	void set_hud_hotkey(morda::key key)noexcept{
+		this->hud_hotkey = key;
+	}
+
 public:
 
 	/**
@@ -231,6 +823,42 @@ public:
 	 */
 	void quit()noexcept;
 
+private:
+	window_params::present_mode present_mode_v = window_params::present_mode::immediate;
+	unsigned max_fps = 0;
+
+public:
+	/**
+	 * @brief Set frame presentation mode.
+	 * The mode is changed without recreating the window.
+	 * @param mode - presentation mode to set.
+	 */
+	void set_present_mode(window_params::present_mode mode);
+
+	/**
+	 * @brief Get current frame presentation mode.
+	 * @return Current presentation mode.
+	 */
+	window_params::present_mode get_present_mode()const noexcept{
+		return this->present_mode_v;
+	}
+
+	/**
+	 * @brief Set maximum frame rate for capped presentation mode.
+	 * @param fps - maximum number of frames per second. Zero means no limit.
+	 */
+	void set_max_fps(unsigned fps)noexcept{
+		this->max_fps = fps;
+	}
+
+	/**
+	 * @brief Get maximum frame rate for capped presentation mode.
+	 * @return Maximum number of frames per second. Zero means no limit.
+	 */
+	unsigned get_max_fps()const noexcept{
+		return this->max_fps;
+	}
+
 private:
 	bool isFullscreen_v = false;
 
@@ -0,0 +1,171 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "frame_profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <utki/debug.hpp>
+
+using namespace mordavokne;
+
+frame_profiler::frame_profiler(size_t capacity) :
+		last_mark(std::chrono::steady_clock::now()),
+		records(capacity)
+{}
+
+void frame_profiler::set_enabled(bool enable){
+	if(enable && !this->enabled){
+		this->clear();
+	}
+	this->enabled = enable;
+}
+
+void frame_profiler::set_capacity(size_t capacity){
+	this->records.resize(capacity);
+	this->records.shrink_to_fit();
+	this->clear();
+}
+
+void frame_profiler::clear()noexcept{
+	this->num_records = 0;
+	this->next_record = 0;
+	this->current = frame_record();
+	this->last_mark = std::chrono::steady_clock::now();
+}
+
+namespace{
+const std::array<const char*, size_t(frame_profiler::phase::enum_size)> phase_names = {{
+	"wait",
+	"ui_queue",
+	"event pump",
+	"gui.update",
+	"render",
+	"swap"
+}};
+}
+
+void frame_profiler::mark_internal(phase p)noexcept{
+	auto now = std::chrono::steady_clock::now();
+
+	if(trace::is_enabled() && now != this->last_mark){
+		trace::record(phase_names[size_t(p)], trace::get_timestamp_ns(this->last_mark), trace::get_timestamp_ns(now));
+	}
+
+	if(this->enabled){
+		this->current.phases[size_t(p)] += std::chrono::duration_cast<std::chrono::microseconds>(now - this->last_mark);
+	}
+
+	this->last_mark = now;
+}
+
+void frame_profiler::end_frame()noexcept{
+	if(!this->enabled){
+		return;
+	}
+
+	this->current.total = std::chrono::microseconds::zero();
+	for(auto& d : this->current.phases){
+		this->current.total += d;
+	}
+
+	if(!this->records.empty()){
+		this->records[this->next_record] = this->current;
+		++this->next_record;
+		if(this->next_record == this->records.size()){
+			this->next_record = 0;
+		}
+		this->num_records = std::min(this->num_records + 1, this->records.size());
+	}
+
+	this->current = frame_record();
+	++this->num_frames;
+}
+
+void frame_profiler::set_gpu_time(uint64_t frame_number, std::chrono::microseconds gpu_time)noexcept{
+	frame_record* r;
+	if(frame_number == this->num_frames){
+		// the frame is still being measured
+		r = &this->current;
+	}else{
+		uint64_t age = this->num_frames - frame_number;
+		if(frame_number > this->num_frames || age > this->num_records){
+			return;
+		}
+		r = &this->records[(this->next_record + this->records.size() - size_t(age)) % this->records.size()];
+	}
+
+	r->gpu_render = gpu_time;
+	r->has_gpu_render = true;
+}
+
+const frame_profiler::frame_record& frame_profiler::operator[](size_t index)const noexcept{
+	ASSERT(index < this->num_records)
+	size_t oldest = this->num_records == this->records.size() ? this->next_record : 0;
+	return this->records[(oldest + index) % this->records.size()];
+}
+
+namespace{
+std::chrono::microseconds get_percentile(std::vector<std::chrono::microseconds>& values, float percent){
+	if(values.empty()){
+		return std::chrono::microseconds::zero();
+	}
+
+	// nearest rank method
+	percent = std::max(0.0f, std::min(percent, 100.0f));
+	size_t rank = size_t(std::ceil(percent / 100 * values.size()));
+	size_t index = rank == 0 ? 0 : rank - 1;
+
+	std::nth_element(values.begin(), std::next(values.begin(), index), values.end());
+	return values[index];
+}
+}
+
+std::chrono::microseconds frame_profiler::get_percentile(float percent)const{
+	std::vector<std::chrono::microseconds> values;
+	values.reserve(this->num_records);
+	for(size_t i = 0; i != this->num_records; ++i){
+		values.push_back(this->records[i].total);
+	}
+	return ::get_percentile(values, percent);
+}
+
+std::chrono::microseconds frame_profiler::get_percentile(float percent, phase p)const{
+	std::vector<std::chrono::microseconds> values;
+	values.reserve(this->num_records);
+	for(size_t i = 0; i != this->num_records; ++i){
+		values.push_back(this->records[i].phases[size_t(p)]);
+	}
+	return ::get_percentile(values, percent);
+}
+
+std::chrono::microseconds frame_profiler::get_gpu_percentile(float percent)const{
+	std::vector<std::chrono::microseconds> values;
+	values.reserve(this->num_records);
+	for(size_t i = 0; i != this->num_records; ++i){
+		if(this->records[i].has_gpu_render){
+			values.push_back(this->records[i].gpu_render);
+		}
+	}
+	return ::get_percentile(values, percent);
+}
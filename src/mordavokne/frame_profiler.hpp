@@ -0,0 +1,280 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <array>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "trace.hpp"
+
+namespace mordavokne{
+
+class application;
+
+/**
+ * @brief Frame timing profiler.
+ * Measures how much time each phase of the main loop takes and keeps the timings of the
+ * last rendered frames in a ring buffer. The time of the main loop cycles which did not render
+ * a frame, e.g. in render on demand mode, is accounted to the next rendered frame.
+ * So, the total time of a frame record is the time between presentations of two consecutive frames.
+ *
+ * The profiler is owned by the application, see application::get_frame_profiler().
+ * By default, the profiler is disabled.
+ */
+class frame_profiler{
+	friend class application;
+
+public:
+	/**
+	 * @brief Main loop phase.
+	 */
+	enum class phase{
+		/**
+		 * @brief Waiting for events.
+		 */
+		wait,
+
+		/**
+		 * @brief Handling UI thread queue messages.
+		 */
+		ui_queue,
+
+		/**
+		 * @brief Handling window system events.
+		 */
+		events,
+
+		/**
+		 * @brief Updating updateables, i.e. morda::gui::update().
+		 */
+		update,
+
+		/**
+		 * @brief Rendering the GUI, i.e. morda::gui::render().
+		 */
+		render,
+
+		/**
+		 * @brief Presenting the rendered frame, i.e. swapping frame buffers.
+		 */
+		swap,
+
+		enum_size
+	};
+
+	friend void mark_frame_phase(application& app, phase p);
+	friend void count_ui_message(application& app);
+
+	/**
+	 * @brief Timings of a single frame.
+	 */
+	struct frame_record{
+		/**
+		 * @brief Durations of main loop phases.
+		 * Indexed by phase enumeration values.
+		 */
+		std::array<std::chrono::microseconds, size_t(phase::enum_size)> phases;
+
+		/**
+		 * @brief Total frame time.
+		 * Time since the previous frame was presented.
+		 */
+		std::chrono::microseconds total;
+
+		/**
+		 * @brief GPU time of rendering.
+		 * Time the GPU spent executing the rendering commands of the frame.
+		 * Only valid if has_gpu_render is true.
+		 */
+		std::chrono::microseconds gpu_render;
+
+		/**
+		 * @brief Whether the GPU time of rendering was measured.
+		 * GPU time is only measured if GPU timing is enabled and the platform supports timer queries.
+		 * Also, the measurement result arrives a few frames later, so the most recent frames usually
+		 * do not have it yet.
+		 */
+		bool has_gpu_render = false;
+
+		/**
+		 * @brief Number of UI queue messages handled during the frame.
+		 */
+		unsigned num_ui_messages = 0;
+
+		frame_record(){
+			this->phases.fill(std::chrono::microseconds::zero());
+			this->total = std::chrono::microseconds::zero();
+			this->gpu_render = std::chrono::microseconds::zero();
+		}
+	};
+
+private:
+	bool enabled = false;
+	bool gpu_timing = false;
+
+	// number of frames ended since the profiler was created
+	uint64_t num_frames = 0;
+
+	std::chrono::steady_clock::time_point last_mark;
+
+	// timings of the frame being measured
+	frame_record current;
+
+	std::vector<frame_record> records;
+	size_t num_records = 0;
+	size_t next_record = 0;
+
+	void mark_internal(phase p)noexcept;
+
+	// Account the time passed since previous mark to the given phase.
+	// If tracing is enabled, the phase is recorded as trace event as well.
+	void mark(phase p)noexcept{
+		if(!this->enabled && !trace::is_enabled()){
+			return;
+		}
+		this->mark_internal(p);
+	}
+
+	void count_ui_message()noexcept{
+		if(this->enabled){
+			++this->current.num_ui_messages;
+		}
+	}
+
+	// store the timings of the frame being measured and start measuring the next frame
+	void end_frame()noexcept;
+
+	// set GPU time of the frame with the given number, it is ignored if the frame record is not in the ring buffer anymore
+	void set_gpu_time(uint64_t frame_number, std::chrono::microseconds gpu_time)noexcept;
+
+public:
+	/**
+	 * @brief Create frame profiler.
+	 * @param capacity - number of most recent frames to keep timings of.
+	 */
+	frame_profiler(size_t capacity = 256);
+
+	/**
+	 * @brief Enable/disable profiling.
+	 * Enabling the profiler clears the collected timings.
+	 * @param enable - whether to enable (true) or disable (false) profiling.
+	 */
+	void set_enabled(bool enable);
+
+	/**
+	 * @brief Check if profiling is enabled.
+	 * @return true if profiling is enabled.
+	 * @return false otherwise.
+	 */
+	bool is_enabled()const noexcept{
+		return this->enabled;
+	}
+
+	/**
+	 * @brief Enable/disable GPU timing.
+	 * When enabled, the GPU time of rendering is measured with timer queries, see frame_record::gpu_render.
+	 * This requires GL_ARB_timer_query on desktop OpenGL or GL_EXT_disjoint_timer_query on OpenGL ES.
+	 * If the extension is not supported, then GPU time is not measured.
+	 * The timer queries are read back without stalling the rendering pipeline, so GPU timing is
+	 * cheap, but it is disabled by default.
+	 * GPU timing only works when profiling is enabled.
+	 * @param enable - whether to enable (true) or disable (false) GPU timing.
+	 */
+	void set_gpu_timing(bool enable)noexcept{
+		this->gpu_timing = enable;
+	}
+
+	/**
+	 * @brief Check if GPU timing is enabled.
+	 * @return true if GPU timing is enabled.
+	 * @return false otherwise.
+	 */
+	bool is_gpu_timing()const noexcept{
+		return this->gpu_timing;
+	}
+
+	/**
+	 * @brief Set ring buffer capacity.
+	 * Clears the collected timings.
+	 * @param capacity - number of most recent frames to keep timings of.
+	 */
+	void set_capacity(size_t capacity);
+
+	/**
+	 * @brief Get ring buffer capacity.
+	 * @return Number of most recent frames to keep timings of.
+	 */
+	size_t capacity()const noexcept{
+		return this->records.size();
+	}
+
+	/**
+	 * @brief Get number of collected frame records.
+	 * @return Number of frame records, not more than capacity().
+	 */
+	size_t size()const noexcept{
+		return this->num_records;
+	}
+
+	/**
+	 * @brief Get frame record.
+	 * @param index - index of the frame record, 0 is the oldest one, size() - 1 is the most recent one.
+	 * @return Frame record.
+	 */
+	const frame_record& operator[](size_t index)const noexcept;
+
+	/**
+	 * @brief Discard collected frame records.
+	 */
+	void clear()noexcept;
+
+	/**
+	 * @brief Get percentile of total frame time.
+	 * @param percent - percentile to get, from 0 to 100, e.g. 50 for median, 99 for the 99th percentile.
+	 * @return Total frame time, which is not exceeded by the given percent of the collected frames.
+	 *         Zero if there are no frame records.
+	 */
+	std::chrono::microseconds get_percentile(float percent)const;
+
+	/**
+	 * @brief Get percentile of main loop phase duration.
+	 * @param percent - percentile to get, from 0 to 100.
+	 * @param p - main loop phase.
+	 * @return Phase duration, which is not exceeded by the given percent of the collected frames.
+	 *         Zero if there are no frame records.
+	 */
+	std::chrono::microseconds get_percentile(float percent, phase p)const;
+
+	/**
+	 * @brief Get percentile of GPU rendering time.
+	 * Only the frame records which have the GPU time measured are taken into account.
+	 * @param percent - percentile to get, from 0 to 100.
+	 * @return GPU rendering time, which is not exceeded by the given percent of the measured frames.
+	 *         Zero if there are no frames with GPU time measured.
+	 */
+	std::chrono::microseconds get_gpu_percentile(float percent)const;
+};
+
+}
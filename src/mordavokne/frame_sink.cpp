@@ -0,0 +1,184 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "frame_sink.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <sstream>
+
+#include <utki/util.hpp>
+
+#include <papki/fs_file.hpp>
+
+using namespace mordavokne;
+
+namespace{
+class raw_stream{
+	papki::fs_file file;
+public:
+	raw_stream(const std::string& path) :
+			file(path)
+	{
+		this->file.open(papki::file::mode::create);
+	}
+
+	~raw_stream()noexcept{
+		this->file.close();
+	}
+
+	void write(const application::frame_image& image){
+		this->file.write(utki::make_span(image.pixels));
+	}
+};
+
+const std::array<uint32_t, 256> crc_table = [](){
+	std::array<uint32_t, 256> ret;
+	for(uint32_t n = 0; n != ret.size(); ++n){
+		uint32_t c = n;
+		for(unsigned k = 0; k != 8; ++k){
+			c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+		}
+		ret[n] = c;
+	}
+	return ret;
+}();
+
+void push_uint32_be(std::vector<uint8_t>& buf, uint32_t v){
+	buf.push_back(uint8_t(v >> 24));
+	buf.push_back(uint8_t(v >> 16));
+	buf.push_back(uint8_t(v >> 8));
+	buf.push_back(uint8_t(v));
+}
+
+void push_chunk(std::vector<uint8_t>& buf, const char* type, const std::vector<uint8_t>& data){
+	push_uint32_be(buf, uint32_t(data.size()));
+
+	size_t crc_start = buf.size();
+	buf.insert(buf.end(), type, type + 4);
+	buf.insert(buf.end(), data.begin(), data.end());
+
+	uint32_t crc = 0xffffffff;
+	for(auto i = std::next(buf.begin(), crc_start); i != buf.end(); ++i){
+		crc = crc_table[(crc ^ *i) & 0xff] ^ (crc >> 8);
+	}
+	push_uint32_be(buf, crc ^ 0xffffffff);
+}
+
+// Encode image as PNG without compression, i.e. zlib stream consists of stored deflate blocks.
+// Frames are dumped on the UI thread, so encoding speed matters more than the file size.
+std::vector<uint8_t> encode_png(const application::frame_image& image){
+	std::vector<uint8_t> ret = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+	{
+		std::vector<uint8_t> ihdr;
+		push_uint32_be(ihdr, image.dims.x());
+		push_uint32_be(ihdr, image.dims.y());
+		ihdr.push_back(8); // bit depth
+		ihdr.push_back(6); // color type: RGBA
+		ihdr.push_back(0); // compression method: deflate
+		ihdr.push_back(0); // filter method: adaptive
+		ihdr.push_back(0); // interlace method: none
+		push_chunk(ret, "IHDR", ihdr);
+	}
+
+	// each row is prefixed with filter type byte
+	size_t stride = size_t(image.dims.x()) * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((stride + 1) * image.dims.y());
+	for(unsigned y = 0; y != image.dims.y(); ++y){
+		raw.push_back(0); // filter type: none
+		auto row = std::next(image.pixels.begin(), stride * y);
+		raw.insert(raw.end(), row, std::next(row, stride));
+	}
+
+	{
+		const size_t max_block_size = 0xffff;
+
+		std::vector<uint8_t> idat;
+		idat.reserve(raw.size() + (raw.size() / max_block_size + 1) * 5 + 6);
+
+		// zlib header: deflate with 32k window, no compression, no preset dictionary
+		idat.push_back(0x78);
+		idat.push_back(0x01);
+
+		size_t pos = 0;
+		do{
+			size_t len = std::min(raw.size() - pos, max_block_size);
+			bool is_final = pos + len == raw.size();
+
+			idat.push_back(is_final ? 1 : 0); // BFINAL bit, BTYPE = 00 (stored)
+			idat.push_back(uint8_t(len));
+			idat.push_back(uint8_t(len >> 8));
+			idat.push_back(uint8_t(~len));
+			idat.push_back(uint8_t(~len >> 8));
+			idat.insert(idat.end(), std::next(raw.begin(), pos), std::next(raw.begin(), pos + len));
+
+			pos += len;
+		}while(pos != raw.size());
+
+		// adler32 checksum of uncompressed data
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for(auto c : raw){
+			a = (a + c) % 65521;
+			b = (b + a) % 65521;
+		}
+		push_uint32_be(idat, (b << 16) | a);
+
+		push_chunk(ret, "IDAT", idat);
+	}
+
+	push_chunk(ret, "IEND", std::vector<uint8_t>());
+
+	return ret;
+}
+}
+
+application::frame_sink_type mordavokne::make_frame_file_sink(const std::string& path, frame_file_format format){
+	switch(format){
+		case frame_file_format::raw:
+			{
+				auto stream = std::make_shared<raw_stream>(path);
+				return [stream](const application::frame_image& image){
+					stream->write(image);
+				};
+			}
+		case frame_file_format::png:
+			return [path](const application::frame_image& image){
+				std::stringstream ss;
+				ss << path << std::setfill('0') << std::setw(6) << image.frame_number << ".png";
+
+				auto png = encode_png(image);
+
+				papki::fs_file file(ss.str());
+				file.open(papki::file::mode::create);
+				utki::scope_exit file_scope_exit([&file](){
+					file.close();
+				});
+				file.write(utki::make_span(png));
+			};
+		default:
+			throw std::invalid_argument("make_frame_file_sink(): unknown frame file format");
+	}
+}
@@ -0,0 +1,61 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <string>
+
+#include "application.hpp"
+
+namespace mordavokne{
+
+/**
+ * @brief Format of the frame files.
+ */
+enum class frame_file_format{
+	/**
+	 * @brief Raw RGBA pixels.
+	 * All frames are written one after another into a single file, without any headers.
+	 * This is the format accepted by video encoders as raw video input,
+	 * e.g. "ffmpeg -f rawvideo -pixel_format rgba -video_size <width>x<height> -i <file>".
+	 * All frames are supposed to be of the same size.
+	 */
+	raw,
+
+	/**
+	 * @brief Sequence of PNG files.
+	 * Each frame is written to a separate PNG file named after the frame number, e.g. "<prefix>000042.png".
+	 * The images are not compressed, so that encoding does not take much time.
+	 */
+	png
+};
+
+/**
+ * @brief Create frame sink which writes the frames to files.
+ * The returned sink is supposed to be passed to application::set_frame_sink().
+ * @param path - for raw format it is the output file name, for PNG format it is the file name prefix.
+ * @param format - format of the frame files.
+ * @return Frame sink.
+ */
+application::frame_sink_type make_frame_file_sink(const std::string& path, frame_file_format format);
+
+}
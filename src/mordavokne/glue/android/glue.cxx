@@ -21,6 +21,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <cerrno>
 #include <ctime>
+#include <algorithm>
 #include <csignal>
 
 #include <android/native_activity.h>
@@ -29,6 +30,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <android/window.h>
 
 #include <utki/unicode.hpp>
+#include <utki/string.hpp>
 #include <nitki/queue.hpp>
 #include <utki/destructable.hpp>
 
@@ -39,6 +41,12 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <morda/render/opengles/renderer.hpp>
 
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "../util.hxx"
+#include "../frame_pacer.hxx"
+#include "../shared_gl_context.hxx"
+#include "../egl_shared_context.cxx"
 
 #include "../friend_accessors.cxx"
 
@@ -177,9 +185,19 @@ struct window_wrapper : public utki::destructable{
 	EGLint format;
 	EGLConfig config;
 
+	// whether EGL_EXT_buffer_age extension is supported
+	bool buffer_age_supported = false;
+
 	nitki::queue ui_queue;
 
-	window_wrapper(const window_params& wp){
+	frame_pacer pacer;
+
+	// whether the background loader context is to be created
+	const bool background_loader;
+
+	window_wrapper(const window_params& wp) :
+			background_loader(wp.background_loader)
+	{
 		this->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 		if(this->display == EGL_NO_DISPLAY){
 			throw std::runtime_error("eglGetDisplay(): failed, no matching display connection found");
@@ -193,13 +211,23 @@ struct window_wrapper : public utki::destructable{
 			throw std::runtime_error("eglInitialize() failed");
 		}
 
+#ifdef EGL_EXT_buffer_age
+		{
+			auto egl_extensions = utki::split(std::string_view(eglQueryString(this->display, EGL_EXTENSIONS)));
+			if(std::find(egl_extensions.begin(), egl_extensions.end(), "EGL_EXT_buffer_age") != egl_extensions.end()){
+				LOG([](auto&o){o << "EGL_EXT_buffer_age is supported\n";})
+				this->buffer_age_supported = true;
+			}
+		}
+#endif
+
 		// TODO: allow stencil configuration etc. via window_params
 
 		// Specify the attributes of the desired configuration.
 		// We need an EGLConfig with at least 8 bits per color
 		// component compatible with on-screen windows.
 		const EGLint attribs[] = {
-				EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+				EGL_SURFACE_TYPE, EGL_WINDOW_BIT | (wp.background_loader ? EGL_PBUFFER_BIT : 0), // pbuffer is for the background loader context
 				EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, // we want OpenGL ES 2.0
 				EGL_BLUE_SIZE, 8,
 				EGL_GREEN_SIZE, 8,
@@ -238,6 +266,8 @@ struct window_wrapper : public utki::destructable{
 			eglDestroyContext(this->display, this->context);
 		});
 
+		this->set_present_mode(wp.present_mode_request);
+
 		this->create_surface();
 
 		eglContextScopeExit.release();
@@ -275,6 +305,11 @@ struct window_wrapper : public utki::destructable{
 			throw std::runtime_error("eglMakeCurrent() failed");
 		}
 
+		// swap interval is a property of the surface bound to the current context
+		if(eglSwapInterval(this->display, this->swap_interval) != EGL_TRUE){
+			throw std::runtime_error("eglSwapInterval() failed");
+		}
+
 		surface_scope_exit.release();
 	}
 
@@ -289,6 +324,22 @@ struct window_wrapper : public utki::destructable{
 		return r4::vector2<unsigned>(width, height);
 	}
 
+	int swap_interval = 1;
+
+	void set_present_mode(window_params::present_mode mode){
+		// negative values are clamped by EGL to the minimum supported swap interval
+		this->swap_interval = std::max(get_swap_interval(mode, false), 0);
+
+		if(this->surface == EGL_NO_SURFACE){
+			// swap interval will be applied when the surface is created
+			return;
+		}
+
+		if(eglSwapInterval(this->display, this->swap_interval) != EGL_TRUE){
+			throw std::runtime_error("eglSwapInterval() failed");
+		}
+	}
+
 	void swap_buffers(){
 		if(this->surface == EGL_NO_SURFACE){
 			return;
@@ -641,6 +692,22 @@ public:
 		ASSERT_INFO(res == 0, " res = " << res << " errno = " << errno)
 	}
 
+	// Arms the timer to expire in dt milliseconds, unless it is already armed to expire earlier.
+	// Note, that zero dt disarms the timer, so it is clamped to 1 millisecond.
+	void arm_no_later(uint32_t dt){
+		dt = std::max(dt, uint32_t(1));
+
+		itimerspec cur;
+		if(timer_gettime(this->timer, &cur) == 0 && (cur.it_value.tv_sec != 0 || cur.it_value.tv_nsec != 0)){
+			uint64_t cur_ms = uint64_t(cur.it_value.tv_sec) * 1000 + uint64_t(cur.it_value.tv_nsec) / 1000000;
+			if(cur_ms <= dt){
+				return;
+			}
+		}
+
+		this->arm(dt);
+	}
+
 	// returns true if timer was disarmed
 	// returns false if timer has fired before it was disarmed.
 	// TODO: this function is not used anywhere, remove?
@@ -662,6 +729,27 @@ public:
 	}
 } timer;
 
+void render_paced(application& app){
+	auto& ww = get_impl(app);
+
+	ww.pacer.set_target(app);
+
+	if(needs_render(app) && !ww.pacer.start_frame()){
+		// It is too early for the next frame. Make the update timer fire by the frame deadline,
+		// the frame will be rendered from on_update_timer_expired().
+		// The timer is only re-armed if the frame deadline is earlier than the pending updateables' deadline.
+		timer.arm_no_later(ww.pacer.get_wait_timeout());
+		return;
+	}
+
+	ww.render(app);
+
+	if(is_readback_pending(app)){
+		// captured frames are to be delivered on the next cycle
+		timer.arm_no_later(1);
+	}
+}
+
 // TODO: this mapping is not final
 const std::array<morda::key, std::uint8_t(-1) + 1> key_code_map = {
 	morda::key::unknown, // AKEYCODE_UNKNOWN
@@ -1037,6 +1125,9 @@ mordavokne::application::application(std::string&& name, const window_params& wp
 			)),
 		storage_dir(initialize_storage_dir(this->name))
 {
+	this->present_mode_v = wp.present_mode_request;
+	this->max_fps = wp.max_fps;
+
 	auto win_size = get_impl(*this).get_window_size();
 	this->update_window_rect(morda::rectangle(morda::vector2(0), win_size.to<morda::real>()));
 }
@@ -1050,6 +1141,37 @@ void mordavokne::application::swap_frame_buffers(){
 	ww.swap_buffers();
 }
 
+void mordavokne::application::set_present_mode(window_params::present_mode mode){
+	get_impl(*this).set_present_mode(mode);
+	this->present_mode_v = mode;
+}
+
+unsigned mordavokne::application::get_buffer_age(){
+	auto& ww = get_impl(*this);
+
+	if(!ww.buffer_age_supported || ww.surface == EGL_NO_SURFACE){
+		return 0;
+	}
+
+#ifdef EGL_EXT_buffer_age
+	EGLint age = 0;
+	if(eglQuerySurface(ww.display, ww.surface, EGL_BUFFER_AGE_EXT, &age) == EGL_FALSE){
+		return 0;
+	}
+	return unsigned(age);
+#else
+	return 0;
+#endif
+}
+
+std::unique_ptr<shared_gl_context> mordavokne::application::create_shared_gl_context(){
+	auto& ww = get_impl(*this);
+	if(!ww.background_loader){
+		return nullptr;
+	}
+	return std::make_unique<egl_shared_context>(ww.display, ww.config, ww.context);
+}
+
 void mordavokne::application::set_mouse_cursor_visible(bool visible){
 	// do nothing
 }
@@ -1105,6 +1227,17 @@ void handle_input_events(){
 
 		bool consume = false;
 
+		if(app.is_input_latency_measurement()){
+			// input event times are CLOCK_MONOTONIC nanoseconds, the same clock as std::chrono::steady_clock uses
+			int64_t event_time = eventType == AINPUT_EVENT_TYPE_MOTION ? AMotionEvent_getEventTime(event) : AKeyEvent_getEventTime(event);
+			note_input_time(
+					app,
+					std::chrono::steady_clock::time_point(
+							std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(event_time))
+						)
+				);
+		}
+
 		switch(eventType){
 			case AINPUT_EVENT_TYPE_MOTION:
 				switch(eventAction & AMOTION_EVENT_ACTION_MASK){
@@ -1248,7 +1381,7 @@ void handle_input_events(){
 		);
 	}
 
-	get_impl(app).render(app);
+	render_paced(app);
 
 	fd_flag.set();
 }
@@ -1350,7 +1483,12 @@ int on_update_timer_expired(int fd, int events, void* data){
 
 	auto& app = application::inst();
 
+	// the looper was idle till now
+	mark_frame_phase(app, frame_profiler::phase::wait);
+
 	uint32_t dt = app.gui.update();
+
+	mark_frame_phase(app, frame_profiler::phase::update);
 	if(dt == 0){
 		// do not arm the timer and do not clear the flag
 	}else{
@@ -1359,7 +1497,8 @@ int on_update_timer_expired(int fd, int events, void* data){
 	}
 
 	// after updating need to re-render everything
-	get_impl(app).render(app);
+	app.invalidate();
+	render_paced(app);
 
 //	LOG([&](auto&o){o << "on_update_timer_expired(): armed timer for " << dt << std::endl;})
 
@@ -1367,12 +1506,21 @@ int on_update_timer_expired(int fd, int events, void* data){
 }
 
 int on_queue_has_messages(int fd, int events, void* data){
-	auto& ww = get_impl(application::inst());
+	auto& app = application::inst();
+	auto& ww = get_impl(app);
+
+	mark_frame_phase(app, frame_profiler::phase::wait);
 
 	while(auto m = ww.ui_queue.pop_front()){
+		trace::scope trace_scope("ui_queue message");
+		count_ui_message(app);
 		m();
 	}
 
+	app.invalidate();
+
+	mark_frame_phase(app, frame_profiler::phase::ui_queue);
+
 	return 1; // 1 means do not remove descriptor from looper
 }
 
@@ -1456,6 +1604,7 @@ void on_native_window_redraw_needed(ANativeActivity* activity, ANativeWindow* wi
 
 	auto& app = get_app(activity);
 
+	app.invalidate();
 	get_impl(app).render(app);
 }
 
@@ -1495,8 +1644,12 @@ int on_input_events_ready_for_reading_from_queue(int fd, int events, void* data)
 
 	ASSERT(mordavokne::application::is_created())
 
+	mark_frame_phase(mordavokne::inst(), frame_profiler::phase::wait);
+
 	handle_input_events();
 
+	mark_frame_phase(mordavokne::inst(), frame_profiler::phase::events);
+
 	return 1; // we don't want to remove input queue descriptor from looper
 }
 
@@ -1554,6 +1707,7 @@ void on_content_rect_changed(ANativeActivity* activity, const ARect* rect){
 		);
 
 	// redraw, since WindowRedrawNeeded not always comes
+	app.invalidate();
 	get_impl(app).render(app);
 }
 }
@@ -0,0 +1,177 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#include "../application.hpp"
+#include "../trace.hpp"
+
+#include "shared_gl_context.hxx"
+
+using namespace mordavokne;
+
+namespace{
+// Executes load tasks on a separate thread with a graphics context which shares objects with the main one.
+class background_loader : public utki::destructable{
+	struct task{
+		std::function<void()> load;
+		std::function<void(std::exception_ptr)> completed;
+	};
+
+	morda::context& context;
+
+	std::unique_ptr<shared_gl_context> gl_context;
+
+	std::mutex mutex;
+	std::condition_variable cond_var;
+	std::deque<task> tasks;
+	bool quit = false;
+
+	std::thread thread;
+
+	void run(){
+		trace::set_thread_name("loader");
+
+		try{
+			this->gl_context->make_current();
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "background loader: " << e.what() << std::endl;})
+			// fall back to loading on the UI thread
+			std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+			this->gl_context.reset();
+			for(auto& t : this->tasks){
+				this->post_to_ui_thread(std::move(t));
+			}
+			this->tasks.clear();
+			return;
+		}
+		utki::scope_exit scope_exit_context([this](){
+			this->gl_context->release();
+		});
+
+		for(;;){
+			task t;
+			{
+				std::unique_lock<decltype(this->mutex)> lock(this->mutex);
+				this->cond_var.wait(lock, [this](){
+					return this->quit || !this->tasks.empty();
+				});
+				if(this->quit){
+					return;
+				}
+				t = std::move(this->tasks.front());
+				this->tasks.pop_front();
+			}
+
+			std::exception_ptr error;
+			try{
+				trace::scope trace_scope("background load");
+				t.load();
+				this->gl_context->wait_for_completion();
+			}catch(...){
+				error = std::current_exception();
+			}
+
+			if(t.completed){
+				this->context.run_from_ui_thread([completed = std::move(t.completed), error](){
+					completed(error);
+				});
+			}
+		}
+	}
+
+	void post_to_ui_thread(task&& t){
+		this->context.run_from_ui_thread([t = std::move(t)](){
+			std::exception_ptr error;
+			try{
+				t.load();
+			}catch(...){
+				error = std::current_exception();
+			}
+			if(t.completed){
+				t.completed(error);
+			}
+		});
+	}
+
+public:
+	background_loader(morda::context& context, std::unique_ptr<shared_gl_context> gl_context) :
+			context(context),
+			gl_context(std::move(gl_context))
+	{
+		if(this->gl_context){
+			this->thread = std::thread([this](){
+				this->run();
+			});
+		}
+	}
+
+	~background_loader()noexcept{
+		if(!this->thread.joinable()){
+			return;
+		}
+		{
+			std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+			this->quit = true;
+		}
+		this->cond_var.notify_one();
+		this->thread.join();
+	}
+
+	void push(task&& t){
+		{
+			std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+			if(this->gl_context){
+				this->tasks.push_back(std::move(t));
+				this->cond_var.notify_one();
+				return;
+			}
+		}
+		this->post_to_ui_thread(std::move(t));
+	}
+
+	void push(std::function<void()>&& load, std::function<void(std::exception_ptr)>&& completed){
+		this->push(task{std::move(load), std::move(completed)});
+	}
+};
+}
+
+void application::load_async(std::function<void()>&& load, std::function<void(std::exception_ptr)>&& completed){
+	if(!this->loader_pimpl){
+		std::unique_ptr<shared_gl_context> gl_context;
+		try{
+			gl_context = this->create_shared_gl_context();
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "shared graphics context could not be created: " << e.what() << std::endl;})
+		}
+		this->loader_pimpl = std::make_unique<background_loader>(*this->gui.context, std::move(gl_context));
+	}
+
+	ASSERT(dynamic_cast<background_loader*>(this->loader_pimpl.get()))
+	static_cast<background_loader&>(*this->loader_pimpl).push(std::move(load), std::move(completed));
+}
@@ -0,0 +1,126 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <algorithm>
+
+#include <utki/util.hpp>
+#include <utki/string.hpp>
+
+#include "shared_gl_context.hxx"
+
+namespace{
+class egl_shared_context : public mordavokne::shared_gl_context{
+	EGLDisplay display;
+	EGLContext context;
+
+	// the context is not used for rendering, so the surface is only created if surfaceless contexts are not supported
+	EGLSurface surface = EGL_NO_SURFACE;
+
+#ifdef EGL_KHR_fence_sync
+	// nullptr if EGL_KHR_fence_sync is not supported
+	PFNEGLCREATESYNCKHRPROC create_sync = nullptr;
+	PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync = nullptr;
+	PFNEGLDESTROYSYNCKHRPROC destroy_sync = nullptr;
+#endif
+
+public:
+	egl_shared_context(EGLDisplay display, EGLConfig config, EGLContext share_context) :
+			display(display)
+	{
+		auto egl_extensions = utki::split(std::string_view(eglQueryString(this->display, EGL_EXTENSIONS)));
+		auto has_extension = [&egl_extensions](std::string_view name){
+			return std::find(egl_extensions.begin(), egl_extensions.end(), name) != egl_extensions.end();
+		};
+
+		{
+			EGLint contextAttrs[] = {
+				EGL_CONTEXT_CLIENT_VERSION, 2, // we want OpenGL ES 2.0
+				EGL_NONE
+			};
+
+			this->context = eglCreateContext(this->display, config, share_context, contextAttrs);
+			if(this->context == EGL_NO_CONTEXT){
+				throw std::runtime_error("eglCreateContext() failed for shared context");
+			}
+		}
+		utki::scope_exit scope_exit_context([this](){
+			eglDestroyContext(this->display, this->context);
+		});
+
+		if(!has_extension("EGL_KHR_surfaceless_context")){
+			EGLint attribs[] = {
+				EGL_WIDTH, 1,
+				EGL_HEIGHT, 1,
+				EGL_NONE
+			};
+			this->surface = eglCreatePbufferSurface(this->display, config, attribs);
+			if(this->surface == EGL_NO_SURFACE){
+				throw std::runtime_error("eglCreatePbufferSurface() failed for shared context, EGL_KHR_surfaceless_context is not supported either");
+			}
+		}
+
+#ifdef EGL_KHR_fence_sync
+		if(has_extension("EGL_KHR_fence_sync")){
+			this->create_sync = reinterpret_cast<PFNEGLCREATESYNCKHRPROC>(eglGetProcAddress("eglCreateSyncKHR"));
+			this->client_wait_sync = reinterpret_cast<PFNEGLCLIENTWAITSYNCKHRPROC>(eglGetProcAddress("eglClientWaitSyncKHR"));
+			this->destroy_sync = reinterpret_cast<PFNEGLDESTROYSYNCKHRPROC>(eglGetProcAddress("eglDestroySyncKHR"));
+			if(!this->client_wait_sync || !this->destroy_sync){
+				this->create_sync = nullptr;
+			}
+		}
+#endif
+
+		scope_exit_context.reset();
+	}
+
+	~egl_shared_context()noexcept{
+		if(this->surface != EGL_NO_SURFACE){
+			eglDestroySurface(this->display, this->surface);
+		}
+		eglDestroyContext(this->display, this->context);
+	}
+
+	void make_current()override{
+		if(eglMakeCurrent(this->display, this->surface, this->surface, this->context) == EGL_FALSE){
+			throw std::runtime_error("eglMakeCurrent() failed for shared context");
+		}
+	}
+
+	void release()noexcept override{
+		eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+
+	void wait_for_completion()override{
+#ifdef EGL_KHR_fence_sync
+		if(this->create_sync){
+			EGLSyncKHR sync = this->create_sync(this->display, EGL_SYNC_FENCE_KHR, nullptr);
+			if(sync != EGL_NO_SYNC_KHR){
+				this->client_wait_sync(this->display, sync, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+				this->destroy_sync(this->display, sync);
+				return;
+			}
+		}
+#endif
+		glFinish();
+	}
+};
+}
@@ -0,0 +1,104 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "frame_pacer.hxx"
+
+#include <thread>
+#include <limits>
+
+using namespace mordavokne;
+
+namespace{
+// Event waiting wakes up this much earlier than the frame deadline, the rest is slept and spun off.
+// The margin covers event waiting timeout rounding to milliseconds and the scheduler wakeup latency.
+const auto wakeup_margin = std::chrono::milliseconds(2);
+
+// The last part of the waiting is spun, because sleeping is not precise enough.
+const auto spin_margin = std::chrono::microseconds(200);
+}
+
+void frame_pacer::set_fps(unsigned fps)noexcept{
+	if(fps == 0){
+		this->period = std::chrono::steady_clock::duration::zero();
+		return;
+	}
+
+	auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / fps;
+	if(period == this->period){
+		return;
+	}
+
+	this->period = period;
+	this->next_frame_time = std::chrono::steady_clock::now();
+}
+
+void frame_pacer::set_target(const application& app)noexcept{
+	if(app.get_present_mode() == window_params::present_mode::capped){
+		this->set_fps(app.get_max_fps());
+	}else{
+		this->set_fps(0);
+	}
+}
+
+uint32_t frame_pacer::get_wait_timeout()const noexcept{
+	if(!this->is_enabled()){
+		return std::numeric_limits<uint32_t>::max();
+	}
+
+	auto remaining = this->next_frame_time - std::chrono::steady_clock::now() - wakeup_margin;
+	if(remaining <= std::chrono::steady_clock::duration::zero()){
+		return 0;
+	}
+
+	return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+}
+
+bool frame_pacer::start_frame()noexcept{
+	if(!this->is_enabled()){
+		return true;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+
+	if(this->next_frame_time - now >= wakeup_margin + std::chrono::milliseconds(1)){
+		// there is at least a millisecond of event waiting before the frame
+		return false;
+	}
+
+	if(this->next_frame_time > now){
+		if(this->next_frame_time - now > spin_margin){
+			std::this_thread::sleep_until(this->next_frame_time - spin_margin);
+		}
+
+		while(std::chrono::steady_clock::now() < this->next_frame_time){
+			std::this_thread::yield();
+		}
+	}else if(now - this->next_frame_time >= this->period){
+		// The frame is late for more than a frame period, e.g. there was nothing to render for a while.
+		// Do not try to catch up, start counting from this frame.
+		this->next_frame_time = now;
+	}
+
+	// next frame deadline is counted from the current frame deadline, so the frame rate does not drift
+	this->next_frame_time += this->period;
+
+	return true;
+}
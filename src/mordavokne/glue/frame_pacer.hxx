@@ -0,0 +1,78 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "../application.hpp"
+
+namespace mordavokne{
+
+/**
+ * @brief Frame pacer.
+ * Limits the rate of rendered frames. The main loop is supposed to wait for the frame deadline
+ * as part of its usual waiting for events, so that input events are still dispatched without delay.
+ * Since the event waiting timeout has only millisecond granularity, the last fraction of the
+ * waiting is done by sleeping and then spinning till the exact deadline.
+ */
+class frame_pacer{
+	std::chrono::steady_clock::duration period = std::chrono::steady_clock::duration::zero();
+
+	std::chrono::steady_clock::time_point next_frame_time;
+
+public:
+	/**
+	 * @brief Set target frame rate.
+	 * @param fps - maximum number of frames per second. Zero disables frame pacing.
+	 */
+	void set_fps(unsigned fps)noexcept;
+
+	/**
+	 * @brief Set target frame rate according to application's presentation mode.
+	 * Frame pacing is only enabled in capped presentation mode.
+	 * @param app - application to take the presentation mode from.
+	 */
+	void set_target(const application& app)noexcept;
+
+	bool is_enabled()const noexcept{
+		return this->period != std::chrono::steady_clock::duration::zero();
+	}
+
+	/**
+	 * @brief Get event waiting timeout.
+	 * @return Number of milliseconds the main loop can wait for events before it has to
+	 *         start the next frame. Maximum uint32_t value if frame pacing is disabled.
+	 */
+	uint32_t get_wait_timeout()const noexcept;
+
+	/**
+	 * @brief Try to start a new frame.
+	 * If the frame deadline is close, then this function sleeps and spins until the deadline.
+	 * @return true if the frame is to be rendered now. In this case the deadline for the next frame is scheduled.
+	 * @return false if it is too early to render the frame, the main loop should wait for events for
+	 *         get_wait_timeout() milliseconds and try again.
+	 */
+	bool start_frame()noexcept;
+};
+
+}
@@ -0,0 +1,247 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include <deque>
+#include <cstring>
+
+#include <utki/config.hpp>
+
+#if M_OS_NAME == M_OS_NAME_IOS
+#	include <OpenGLES/ES2/gl.h>
+#elif M_OS_NAME == M_OS_NAME_ANDROID || defined(MORDAVOKNE_RENDER_OPENGLES)
+#	include <GLES2/gl2.h>
+#else
+#	include <GL/glew.h>
+#endif
+
+#include "../application.hpp"
+
+using namespace mordavokne;
+
+namespace{
+// Reads back the frame buffer contents.
+// Where pixel buffer objects are supported (desktop OpenGL), the pixels are read into a PBO,
+// which is mapped only a few frames later when the transfer has most probably completed, so
+// the pipeline is not stalled. OpenGL ES 2 has no PBOs, so there the pixels are read synchronously.
+class frame_reader : public utki::destructable{
+	struct readback{
+		r4::vector2<unsigned> dims;
+		uint64_t frame_number;
+		std::function<void(application::frame_image&&)> deliver;
+
+		// pixel buffer object, 0 if the pixels were read synchronously into the 'pixels' vector
+		GLuint pbo = 0;
+		std::vector<uint8_t> pixels;
+	};
+
+	std::deque<readback> in_flight;
+
+	std::vector<GLuint> free_pbos;
+
+	bool pbo_supported;
+
+public:
+	frame_reader(){
+#ifdef GL_PIXEL_PACK_BUFFER
+		this->pbo_supported = GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object;
+#else
+		this->pbo_supported = false;
+#endif
+	}
+
+	~frame_reader()noexcept{
+#ifdef GL_PIXEL_PACK_BUFFER
+		for(auto& rb : this->in_flight){
+			if(rb.pbo != 0){
+				this->free_pbos.push_back(rb.pbo);
+			}
+		}
+		if(!this->free_pbos.empty()){
+			glDeleteBuffers(GLsizei(this->free_pbos.size()), this->free_pbos.data());
+		}
+#endif
+	}
+
+	void read(
+			const r4::rectangle<int>& rect,
+			uint64_t frame_number,
+			std::function<void(application::frame_image&&)>&& deliver
+		)
+	{
+		readback rb;
+		rb.dims = r4::vector2<unsigned>(unsigned(rect.d.x()), unsigned(rect.d.y()));
+		rb.frame_number = frame_number;
+		rb.deliver = std::move(deliver);
+
+		size_t size = size_t(rb.dims.x()) * size_t(rb.dims.y()) * 4;
+
+		// RGBA pixel rows are always 4-byte aligned
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+#ifdef GL_PIXEL_PACK_BUFFER
+		if(this->pbo_supported){
+			if(this->free_pbos.empty()){
+				GLuint pbo;
+				glGenBuffers(1, &pbo);
+				this->free_pbos.push_back(pbo);
+			}
+			rb.pbo = this->free_pbos.back();
+			this->free_pbos.pop_back();
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+			glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_READ);
+			// with pixel pack buffer bound this only schedules the transfer
+			glReadPixels(rect.p.x(), rect.p.y(), rect.d.x(), rect.d.y(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			this->in_flight.push_back(std::move(rb));
+			return;
+		}
+#endif
+
+		rb.pixels.resize(size);
+		glReadPixels(rect.p.x(), rect.p.y(), rect.d.x(), rect.d.y(), GL_RGBA, GL_UNSIGNED_BYTE, rb.pixels.data());
+
+		this->in_flight.push_back(std::move(rb));
+	}
+
+	// deliver read back frames, except the 'keep' most recent ones
+	void collect(size_t keep){
+		while(this->in_flight.size() > keep){
+			readback rb = std::move(this->in_flight.front());
+			this->in_flight.pop_front();
+
+			application::frame_image image;
+			image.dims = rb.dims;
+			image.frame_number = rb.frame_number;
+
+			size_t stride = size_t(rb.dims.x()) * 4;
+			image.pixels.resize(stride * rb.dims.y());
+
+			const uint8_t* src = rb.pixels.data();
+
+#ifdef GL_PIXEL_PACK_BUFFER
+			if(rb.pbo != 0){
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+				src = static_cast<const uint8_t*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+			}
+#endif
+
+			if(src){
+				// OpenGL rows go from bottom to top, flip them
+				for(unsigned y = 0; y != rb.dims.y(); ++y){
+					memcpy(
+							image.pixels.data() + stride * (rb.dims.y() - 1 - y),
+							src + stride * y,
+							stride
+						);
+				}
+			}
+
+#ifdef GL_PIXEL_PACK_BUFFER
+			if(rb.pbo != 0){
+				if(src){
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				}
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+				this->free_pbos.push_back(rb.pbo);
+			}
+#endif
+
+			if(!src){
+				// mapping failed, the frame is lost
+				continue;
+			}
+
+			rb.deliver(std::move(image));
+		}
+	}
+};
+
+frame_reader& get_frame_reader(std::unique_ptr<utki::destructable>& pimpl){
+	if(!pimpl){
+		pimpl = std::make_unique<frame_reader>();
+	}
+	ASSERT(dynamic_cast<frame_reader*>(pimpl.get()))
+	return static_cast<frame_reader&>(*pimpl);
+}
+
+// number of most recent frames to keep in flight, gives the GPU time to complete the transfers
+const size_t num_frames_in_flight = 2;
+}
+
+void application::read_frame(){
+	r4::rectangle<int> viewport(
+			int(this->curWinRect.p.x()),
+			int(this->curWinRect.p.y()),
+			int(this->curWinRect.d.x()),
+			int(this->curWinRect.d.y())
+		);
+
+	if(!viewport.d.is_positive()){
+		return;
+	}
+
+	if(this->render_on_demand && (!this->capture_callbacks.empty() || this->frame_sink)){
+		// make sure there will be one more main loop cycle to deliver the captured frame
+		this->readback_pending = true;
+	}
+
+	get_frame_reader(this->frame_reader_pimpl).read(
+			viewport,
+			this->frame_stats.num_rendered,
+			[callbacks = std::move(this->capture_callbacks), sink = this->frame_sink](frame_image&& image){
+				if(sink){
+					sink(image);
+				}
+				for(auto i = callbacks.begin(); i != callbacks.end(); ++i){
+					if(std::next(i) == callbacks.end()){
+						(*i)(std::move(image));
+					}else{
+						(*i)(frame_image(image));
+					}
+				}
+			}
+		);
+	this->capture_callbacks.clear();
+}
+
+void application::collect_read_frames(bool all){
+	if(all){
+		this->readback_pending = false;
+	}
+
+	if(!this->frame_reader_pimpl){
+		return;
+	}
+	get_frame_reader(this->frame_reader_pimpl).collect(all ? 0 : num_frames_in_flight);
+}
+
+void application::capture_frame(capture_callback_type&& callback){
+	this->capture_callbacks.push_back(std::move(callback));
+	this->invalidate();
+}
+
+void application::set_frame_sink(frame_sink_type&& sink){
+	this->collect_read_frames(true);
+	this->frame_sink = std::move(sink);
+	this->invalidate();
+}
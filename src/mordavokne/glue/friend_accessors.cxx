@@ -19,37 +19,114 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 /* ================ LICENSE END ================ */
 
+#include "input_log.hxx"
+#include "res_watcher.hxx"
+
 namespace mordavokne{
 
 const decltype(application::window_pimpl)& get_window_pimpl(application& app){
 	return app.window_pimpl;
 }
 
+#ifdef MORDAVOKNE_RES_WATCHER
+res_watcher* get_res_watcher(application& app){
+	ASSERT(!app.res_watcher_pimpl || dynamic_cast<res_watcher*>(app.res_watcher_pimpl.get()))
+	return static_cast<res_watcher*>(app.res_watcher_pimpl.get());
+}
+#endif
+
+bool needs_render(const application& app){
+	return app.needs_render();
+}
+
+bool is_readback_pending(const application& app){
+	return app.readback_pending;
+}
+
 void render(application& app){
 	app.render();
 }
 
 void update_window_rect(application& app, const morda::rectangle& rect){
+	if(app.is_input_recording()){
+		input_event e;
+		e.t = input_event::type::window_rect;
+		e.rect = rect;
+		record_input(app, std::move(e));
+	}
 	app.update_window_rect(rect);
 }
 
 void handle_mouse_move(application& app, const r4::vector2<float>& pos, unsigned id){
+	if(app.is_input_recording()){
+		input_event e;
+		e.t = input_event::type::mouse_move;
+		e.pos = pos;
+		e.pointer_id = id;
+		record_input(app, std::move(e));
+	}
 	app.handle_mouse_move(pos, id);
 }
 
 void handle_mouse_button(application& app, bool isDown, const r4::vector2<float>& pos, morda::mouse_button button, unsigned id){
+	if(app.is_input_recording()){
+		input_event e;
+		e.t = input_event::type::mouse_button;
+		e.is_down = isDown;
+		e.pos = pos;
+		e.button = button;
+		e.pointer_id = id;
+		record_input(app, std::move(e));
+	}
 	app.handle_mouse_button(isDown, pos, button, id);
 }
 
 void handleMouseHover(application& app, bool isHovered, unsigned pointerID){
+	if(app.is_input_recording()){
+		input_event e;
+		e.t = input_event::type::mouse_hover;
+		e.is_down = isHovered;
+		e.pointer_id = pointerID;
+		record_input(app, std::move(e));
+	}
 	app.handleMouseHover(isHovered, pointerID);
 }
 
+void note_input_time(application& app, std::chrono::steady_clock::time_point time){
+	app.note_input_time(time);
+}
+
+bool should_coalesce_motion(const application& app){
+	return app.should_coalesce_motion();
+}
+
+void mark_frame_phase(application& app, frame_profiler::phase p){
+	app.frame_prof.mark(p);
+}
+
+void count_ui_message(application& app){
+	app.frame_prof.count_ui_message();
+}
+
 void handle_character_input(application& app, const morda::gui::input_string_provider& string_provider, morda::key key_code){
+	if(app.is_input_recording()){
+		input_event e;
+		e.t = input_event::type::character_input;
+		e.key = key_code;
+		e.chars = string_provider.get();
+		record_input(app, std::move(e));
+	}
 	app.handle_character_input(string_provider, key_code);
 }
 
 void handle_key_event(application& app, bool is_down, morda::key key_code){
+	if(app.is_input_recording()){
+		input_event e;
+		e.t = input_event::type::key;
+		e.is_down = is_down;
+		e.key = key_code;
+		record_input(app, std::move(e));
+	}
 	app.handle_key_event(is_down, key_code);
 }
 
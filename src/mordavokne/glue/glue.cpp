@@ -25,6 +25,10 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #	include "windows/glue.cxx"
 #elif M_OS == M_OS_LINUX && M_OS_NAME == M_OS_NAME_ANDROID
 #	include "android/glue.cxx"
+#elif M_OS == M_OS_LINUX && defined(MORDAVOKNE_WINDOW_WAYLAND)
+#	include "wayland/glue.cxx"
+#elif M_OS == M_OS_LINUX && defined(MORDAVOKNE_WINDOW_HEADLESS)
+#	include "headless/glue.cxx"
 #elif M_OS == M_OS_LINUX
 #	include "linux/glue.cxx"
 #endif
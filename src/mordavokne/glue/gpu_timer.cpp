@@ -0,0 +1,279 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <deque>
+#include <cstring>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#if M_OS_NAME == M_OS_NAME_IOS
+#	include <OpenGLES/ES2/gl.h>
+#elif M_OS_NAME == M_OS_NAME_ANDROID || defined(MORDAVOKNE_RENDER_OPENGLES)
+#	include <EGL/egl.h>
+#	include <GLES2/gl2.h>
+#	include <GLES2/gl2ext.h>
+#	define MORDAVOKNE_GPU_TIMER_EXT
+#else
+#	include <GL/glew.h>
+#	define MORDAVOKNE_GPU_TIMER_ARB
+#endif
+
+#include "../application.hpp"
+
+using namespace mordavokne;
+
+namespace{
+// Measures GPU time of rendering with timer queries.
+// The query results become available a few frames later, so these are polled without blocking,
+// and if the GPU lags behind too much then the frame is just not measured.
+class gpu_timer : public utki::destructable{
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+	// GL_EXT_disjoint_timer_query functions, OpenGL ES does not have timer queries in core
+	PFNGLGENQUERIESEXTPROC glGenQueriesEXT = nullptr;
+	PFNGLDELETEQUERIESEXTPROC glDeleteQueriesEXT = nullptr;
+	PFNGLBEGINQUERYEXTPROC glBeginQueryEXT = nullptr;
+	PFNGLENDQUERYEXTPROC glEndQueryEXT = nullptr;
+	PFNGLGETQUERYOBJECTUIVEXTPROC glGetQueryObjectuivEXT = nullptr;
+	PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT = nullptr;
+#endif
+
+	struct measurement{
+		GLuint query;
+		uint64_t frame_number;
+	};
+
+	std::deque<measurement> in_flight;
+
+	std::vector<GLuint> free_queries;
+
+	bool is_measuring = false;
+
+	bool supported = false;
+
+	// maximum number of queries waiting for results
+	const size_t max_in_flight = 5;
+
+	void gen_query(GLuint* query){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		this->glGenQueriesEXT(1, query);
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		glGenQueries(1, query);
+#endif
+	}
+
+	void begin_query(GLuint query){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		this->glBeginQueryEXT(GL_TIME_ELAPSED_EXT, query);
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		glBeginQuery(GL_TIME_ELAPSED, query);
+#endif
+	}
+
+	void end_query(){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		this->glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		glEndQuery(GL_TIME_ELAPSED);
+#endif
+	}
+
+	bool is_available(GLuint query){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		GLuint available = GL_FALSE;
+		this->glGetQueryObjectuivEXT(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+		return available != GL_FALSE;
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		return available != GL_FALSE;
+#else
+		return false;
+#endif
+	}
+
+	uint64_t get_result_ns(GLuint query){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		khronos_uint64_t ns = 0;
+		this->glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT_EXT, &ns);
+		return uint64_t(ns);
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		GLuint64 ns = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+		return uint64_t(ns);
+#else
+		return 0;
+#endif
+	}
+
+	// Check if GPU timer was reset, e.g. due to power management. This invalidates all the pending results.
+	bool is_disjoint(){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		GLint disjoint = GL_FALSE;
+		glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+		return disjoint != GL_FALSE;
+#else
+		return false;
+#endif
+	}
+
+public:
+	gpu_timer(){
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		auto exts = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+		if(exts && std::strstr(exts, "GL_EXT_disjoint_timer_query")){
+			this->glGenQueriesEXT = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(eglGetProcAddress("glGenQueriesEXT"));
+			this->glDeleteQueriesEXT = reinterpret_cast<PFNGLDELETEQUERIESEXTPROC>(eglGetProcAddress("glDeleteQueriesEXT"));
+			this->glBeginQueryEXT = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(eglGetProcAddress("glBeginQueryEXT"));
+			this->glEndQueryEXT = reinterpret_cast<PFNGLENDQUERYEXTPROC>(eglGetProcAddress("glEndQueryEXT"));
+			this->glGetQueryObjectuivEXT = reinterpret_cast<PFNGLGETQUERYOBJECTUIVEXTPROC>(eglGetProcAddress("glGetQueryObjectuivEXT"));
+			this->glGetQueryObjectui64vEXT = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(eglGetProcAddress("glGetQueryObjectui64vEXT"));
+
+			this->supported =
+					this->glGenQueriesEXT &&
+					this->glDeleteQueriesEXT &&
+					this->glBeginQueryEXT &&
+					this->glEndQueryEXT &&
+					this->glGetQueryObjectuivEXT &&
+					this->glGetQueryObjectui64vEXT;
+
+			if(this->supported){
+				// reset the disjoint flag
+				this->is_disjoint();
+			}
+		}
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		this->supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+#endif
+		if(!this->supported){
+			LOG([](auto&o){o << "gpu_timer: timer queries are not supported" << std::endl;})
+		}
+	}
+
+	~gpu_timer()noexcept{
+		for(auto& m : this->in_flight){
+			this->free_queries.push_back(m.query);
+		}
+		if(this->free_queries.empty()){
+			return;
+		}
+#if defined(MORDAVOKNE_GPU_TIMER_EXT)
+		this->glDeleteQueriesEXT(GLsizei(this->free_queries.size()), this->free_queries.data());
+#elif defined(MORDAVOKNE_GPU_TIMER_ARB)
+		glDeleteQueries(GLsizei(this->free_queries.size()), this->free_queries.data());
+#endif
+	}
+
+	void begin(uint64_t frame_number){
+		ASSERT(!this->is_measuring)
+
+		if(!this->supported){
+			return;
+		}
+
+		if(this->free_queries.empty()){
+			if(this->in_flight.size() >= this->max_in_flight){
+				// GPU lags too much behind, do not measure this frame
+				return;
+			}
+			GLuint query;
+			this->gen_query(&query);
+			this->free_queries.push_back(query);
+		}
+
+		GLuint query = this->free_queries.back();
+		this->free_queries.pop_back();
+
+		this->begin_query(query);
+		this->in_flight.push_back(measurement{query, frame_number});
+		this->is_measuring = true;
+	}
+
+	void end(){
+		if(!this->is_measuring){
+			return;
+		}
+		this->end_query();
+		this->is_measuring = false;
+	}
+
+	// deliver available results, never blocks
+	void collect(const std::function<void(uint64_t frame_number, std::chrono::microseconds gpu_time)>& deliver){
+		ASSERT(!this->is_measuring)
+
+		if(this->in_flight.empty()){
+			return;
+		}
+
+		// results are available in the order the queries were issued
+		std::vector<std::pair<uint64_t, std::chrono::microseconds>> results;
+		while(!this->in_flight.empty()){
+			auto& m = this->in_flight.front();
+			if(!this->is_available(m.query)){
+				break;
+			}
+			results.push_back(std::make_pair(
+					m.frame_number,
+					std::chrono::microseconds(this->get_result_ns(m.query) / 1000)
+				));
+			this->free_queries.push_back(m.query);
+			this->in_flight.pop_front();
+		}
+
+		if(this->is_disjoint()){
+			// the results are not reliable
+			return;
+		}
+
+		for(auto& r : results){
+			deliver(r.first, r.second);
+		}
+	}
+};
+
+gpu_timer& get_gpu_timer(std::unique_ptr<utki::destructable>& pimpl){
+	if(!pimpl){
+		pimpl = std::make_unique<gpu_timer>();
+	}
+	ASSERT(dynamic_cast<gpu_timer*>(pimpl.get()))
+	return static_cast<gpu_timer&>(*pimpl);
+}
+}
+
+void application::begin_gpu_timing(){
+	if(!this->frame_prof.is_enabled() || !this->frame_prof.is_gpu_timing()){
+		return;
+	}
+	get_gpu_timer(this->gpu_timer_pimpl).begin(this->frame_prof.num_frames);
+}
+
+void application::end_gpu_timing(){
+	if(!this->gpu_timer_pimpl){
+		return;
+	}
+
+	auto& t = get_gpu_timer(this->gpu_timer_pimpl);
+	t.end();
+	t.collect([this](uint64_t frame_number, std::chrono::microseconds gpu_time){
+		this->frame_prof.set_gpu_time(frame_number, gpu_time);
+	});
+}
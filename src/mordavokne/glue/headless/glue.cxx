@@ -0,0 +1,391 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include <opros/wait_set.hpp>
+#include <papki/fs_file.hpp>
+
+#include <utki/string.hpp>
+
+#ifdef MORDAVOKNE_RENDER_OPENGLES
+#	include <EGL/egl.h>
+#	include <EGL/eglext.h>
+#	include <GLES2/gl2.h>
+
+#	include <morda/render/opengles/renderer.hpp>
+#else
+#	error "Headless backend only supports OpenGL ES"
+#endif
+
+#include "../../application.hpp"
+#include "../../headless.hpp"
+
+#include "../frame_pacer.hxx"
+#include "../input_log.hxx"
+#include "../message_queue.hxx"
+#include "../program_cache.hxx"
+#include "../egl_shared_context.cxx"
+
+#include "../friend_accessors.cxx"
+#include "../unix_common.cxx"
+
+using namespace mordavokne;
+
+namespace{
+struct window_wrapper : public utki::destructable{
+	// the storage directory is needed by the program binary cache before the application's member is initialized
+	const std::string storage_dir;
+
+	EGLDisplay eglDisplay;
+	EGLSurface eglSurface;
+	EGLContext eglContext;
+	EGLConfig eglConfig;
+
+	message_queue ui_queue;
+
+	frame_pacer pacer;
+
+	// quit after rendering this number of frames, 0 means no limit
+	uint64_t max_frames = 0;
+
+	volatile bool quitFlag = false;
+
+	// whether the background loader context is to be created
+	const bool background_loader;
+
+	window_wrapper(const window_params& wp, const std::string& app_name) :
+			storage_dir(initialize_storage_dir(app_name)),
+			background_loader(wp.background_loader)
+	{
+		if(const char* frames = getenv("MORDAVOKNE_HEADLESS_FRAMES")){
+			this->max_frames = std::strtoull(frames, nullptr, 10);
+		}
+
+		// Prefer the surfaceless platform, it does not need any window system or GPU device,
+		// e.g. Mesa's llvmpipe works with it. Fall back to the default display otherwise.
+		this->eglDisplay = EGL_NO_DISPLAY;
+#if defined(EGL_EXT_platform_base) && defined(EGL_PLATFORM_SURFACELESS_MESA)
+		{
+			auto client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+			if(client_extensions){
+				auto exts = utki::split(std::string_view(client_extensions));
+				if(std::find(exts.begin(), exts.end(), "EGL_MESA_platform_surfaceless") != exts.end()){
+					auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+							eglGetProcAddress("eglGetPlatformDisplayEXT")
+						);
+					if(get_platform_display){
+						this->eglDisplay = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+					}
+				}
+			}
+		}
+#endif
+		if(this->eglDisplay == EGL_NO_DISPLAY){
+			this->eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+		if(this->eglDisplay == EGL_NO_DISPLAY){
+			throw std::runtime_error("eglGetDisplay(): failed, no matching display connection found");
+		}
+
+		utki::scope_exit scopeExitEGLDisplay([this](){
+			eglTerminate(this->eglDisplay);
+		});
+
+		if(eglInitialize(this->eglDisplay, nullptr, nullptr) == EGL_FALSE){
+			throw std::runtime_error("eglInitialize() failed");
+		}
+
+		{
+			std::vector<EGLint> attribs = {
+				EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+				EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, // we want OpenGL ES 2.0
+				EGL_BLUE_SIZE, 8,
+				EGL_GREEN_SIZE, 8,
+				EGL_RED_SIZE, 8,
+				EGL_ALPHA_SIZE, 8
+			};
+			if(wp.buffers.get(window_params::buffer_type::depth)){
+				attribs.push_back(EGL_DEPTH_SIZE);
+				attribs.push_back(16);
+			}
+			if(wp.buffers.get(window_params::buffer_type::stencil)){
+				attribs.push_back(EGL_STENCIL_SIZE);
+				attribs.push_back(8);
+			}
+			attribs.push_back(EGL_NONE);
+
+			EGLint numConfigs;
+			eglChooseConfig(this->eglDisplay, attribs.data(), &eglConfig, 1, &numConfigs);
+			if(numConfigs <= 0){
+				throw std::runtime_error("eglChooseConfig() failed, no matching config found");
+			}
+		}
+
+		if(eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE){
+			throw std::runtime_error("eglBindApi() failed");
+		}
+
+		{
+			EGLint attribs[] = {
+				EGL_WIDTH, EGLint(wp.dims.x()),
+				EGL_HEIGHT, EGLint(wp.dims.y()),
+				EGL_NONE
+			};
+			this->eglSurface = eglCreatePbufferSurface(this->eglDisplay, eglConfig, attribs);
+			if(this->eglSurface == EGL_NO_SURFACE){
+				throw std::runtime_error("eglCreatePbufferSurface() failed");
+			}
+		}
+		utki::scope_exit scopeExitEGLSurface([this](){
+			eglDestroySurface(this->eglDisplay, this->eglSurface);
+		});
+
+		{
+			EGLint contextAttrs[] = {
+				EGL_CONTEXT_CLIENT_VERSION, 2, // we want OpenGL ES 2.0
+				EGL_NONE
+			};
+
+			this->eglContext = eglCreateContext(this->eglDisplay, eglConfig, EGL_NO_CONTEXT, contextAttrs);
+			if(this->eglContext == EGL_NO_CONTEXT){
+				throw std::runtime_error("eglCreateContext() failed");
+			}
+		}
+
+		if(eglMakeCurrent(this->eglDisplay, this->eglSurface, this->eglSurface, this->eglContext) == EGL_FALSE){
+			eglDestroyContext(this->eglDisplay, this->eglContext);
+			throw std::runtime_error("eglMakeCurrent() failed");
+		}
+
+		scopeExitEGLDisplay.reset();
+		scopeExitEGLSurface.reset();
+	}
+
+	~window_wrapper()noexcept{
+		eglMakeCurrent(this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(this->eglDisplay, this->eglContext);
+		eglDestroySurface(this->eglDisplay, this->eglSurface);
+		eglTerminate(this->eglDisplay);
+	}
+};
+
+window_wrapper& get_impl(const std::unique_ptr<utki::destructable>& pimpl){
+	ASSERT(dynamic_cast<window_wrapper*>(pimpl.get()))
+	return static_cast<window_wrapper&>(*pimpl);
+}
+
+window_wrapper& get_impl(application& app){
+	return get_impl(get_window_pimpl(app));
+}
+
+}
+
+application::application(std::string&& name, const window_params& wp) :
+		name(name),
+		window_pimpl(std::make_unique<window_wrapper>(wp, this->name)),
+		gui(std::make_shared<morda::context>(
+				[this, &wp](){
+					if(wp.program_binary_cache){
+						enable_program_binary_cache(get_impl(this->window_pimpl).storage_dir);
+					}
+					return std::make_shared<morda::render_opengles::renderer>();
+				}(),
+				std::make_shared<morda::updater>(),
+				[this](std::function<void()>&& a){
+					get_impl(get_window_pimpl(*this)).ui_queue.push_back(std::move(a));
+				},
+				[](morda::mouse_cursor c){
+					// there is no mouse cursor in headless mode
+				},
+				morda::real(96), // dots per inch
+				morda::real(1) // dots per dp
+			)),
+		storage_dir(get_impl(window_pimpl).storage_dir)
+{
+	this->present_mode_v = wp.present_mode_request;
+	this->max_fps = wp.max_fps;
+
+	this->update_window_rect(
+			morda::rectangle(
+					0,
+					0,
+					morda::real(wp.dims.x()),
+					morda::real(wp.dims.y())
+				)
+		);
+}
+
+void application::quit()noexcept{
+	auto& ww = get_impl(*this);
+
+	ww.quitFlag = true;
+}
+
+int main(int argc, const char** argv){
+	std::unique_ptr<mordavokne::application> app = createAppUnix(argc, argv);
+	if(!app){
+		return 0;
+	}
+
+	ASSERT(app)
+
+	auto& ww = get_impl(*app);
+
+	opros::wait_set wait_set(1);
+
+	wait_set.add(ww.ui_queue, {opros::ready::read});
+
+	while(!ww.quitFlag){
+		uint32_t update_timeout = app->gui.update();
+
+		mark_frame_phase(*app, frame_profiler::phase::update);
+
+		ww.pacer.set_target(*app);
+
+		uint32_t timeout = update_timeout;
+		if(needs_render(*app)){
+			// there is no presentation throttling, so do not wait at all unless the frame rate is capped
+			timeout = ww.pacer.is_enabled() ? std::min(timeout, ww.pacer.get_wait_timeout()) : 0;
+		}
+		if(is_readback_pending(*app)){
+			// captured frames are to be delivered on the next main loop cycle, which is subject to frame pacing
+			timeout = ww.pacer.is_enabled() ? std::min(timeout, ww.pacer.get_wait_timeout()) : 0;
+		}
+
+		auto num_waitables_triggered = wait_set.wait(timeout);
+
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
+		if(num_waitables_triggered == 0 && timeout == update_timeout){
+			// waiting has timed out, this means that it's time to update the updateables, which will change the GUI
+			app->invalidate();
+		}
+
+		if(ww.ui_queue.flags().get(opros::ready::read)){
+			ww.ui_queue.drain([&app](message& m){
+				trace::scope trace_scope("ui_queue message");
+				count_ui_message(*app);
+				m();
+			});
+			app->invalidate();
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::ui_queue);
+
+		if(needs_render(*app) && !ww.pacer.start_frame()){
+			continue;
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
+		render(*app);
+
+		if(ww.max_frames != 0 && app->get_frame_statistics().num_rendered >= ww.max_frames){
+			ww.quitFlag = true;
+		}
+	}
+
+	wait_set.remove(ww.ui_queue);
+
+	return 0;
+}
+
+void application::set_fullscreen(bool enable){
+	// there is no screen, so the window size stays the same
+	this->isFullscreen_v = enable;
+}
+
+void application::set_mouse_cursor_visible(bool visible){
+	// there is no mouse cursor in headless mode
+}
+
+void application::set_present_mode(window_params::present_mode mode){
+	// There is no presentation, only capped mode makes sense since it limits the frame rate.
+	this->present_mode_v = mode;
+}
+
+void application::swap_frame_buffers(){
+	// Swapping pbuffer is a no-op, so wait for the rendering to complete instead.
+	// This way the frame time includes the actual rendering time.
+	glFinish();
+}
+
+unsigned application::get_buffer_age(){
+	return 0;
+}
+
+std::unique_ptr<shared_gl_context> application::create_shared_gl_context(){
+	auto& ww = get_impl(*this);
+	if(!ww.background_loader){
+		return nullptr;
+	}
+	return std::make_unique<egl_shared_context>(ww.eglDisplay, ww.eglConfig, ww.eglContext);
+}
+
+namespace mordavokne{
+namespace headless{
+
+void inject_mouse_move(const r4::vector2<float>& pos, unsigned pointer_id){
+	get_impl(application::inst()).ui_queue.push_back([pos, pointer_id](){
+		handle_mouse_move(application::inst(), pos, pointer_id);
+	});
+}
+
+void inject_mouse_button(bool is_down, const r4::vector2<float>& pos, morda::mouse_button button, unsigned pointer_id){
+	get_impl(application::inst()).ui_queue.push_back([is_down, pos, button, pointer_id](){
+		handle_mouse_button(application::inst(), is_down, pos, button, pointer_id);
+	});
+}
+
+void inject_mouse_hover(bool is_hovered, unsigned pointer_id){
+	get_impl(application::inst()).ui_queue.push_back([is_hovered, pointer_id](){
+		handleMouseHover(application::inst(), is_hovered, pointer_id);
+	});
+}
+
+void inject_key(bool is_down, morda::key key){
+	get_impl(application::inst()).ui_queue.push_back([is_down, key](){
+		handle_key_event(application::inst(), is_down, key);
+	});
+}
+
+void inject_character_input(std::u32string chars, morda::key key){
+	get_impl(application::inst()).ui_queue.push_back([chars = std::move(chars), key](){
+		u32string_provider provider(chars);
+
+		handle_character_input(application::inst(), provider, key);
+	});
+}
+
+void inject_resize(const r4::vector2<unsigned>& dims){
+	get_impl(application::inst()).ui_queue.push_back([dims](){
+		update_window_rect(
+				application::inst(),
+				morda::rectangle(0, 0, morda::real(dims.x()), morda::real(dims.y()))
+			);
+	});
+}
+
+}
+}
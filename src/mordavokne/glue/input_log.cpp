@@ -0,0 +1,438 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "input_log.hxx"
+
+#include <cstring>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#include <papki/fs_file.hpp>
+
+using namespace mordavokne;
+
+namespace{
+const std::array<uint8_t, 8> signature = {{'M', 'R', 'D', 'V', 'I', 'N', 'P', 'T'}};
+const uint8_t format_version = 1;
+
+void write_varint(std::vector<uint8_t>& buf, uint64_t v){
+	while(v >= 0x80){
+		buf.push_back(uint8_t(v) | 0x80);
+		v >>= 7;
+	}
+	buf.push_back(uint8_t(v));
+}
+
+void write_float(std::vector<uint8_t>& buf, float f){
+	static_assert(sizeof(float) == sizeof(uint32_t), "float must be 32 bit");
+	uint32_t v;
+	std::memcpy(&v, &f, sizeof(v));
+	for(unsigned i = 0; i != 4; ++i){
+		buf.push_back(uint8_t(v >> (i * 8)));
+	}
+}
+
+class reader{
+	utki::span<const uint8_t> data;
+	size_t pos = 0;
+public:
+	reader(utki::span<const uint8_t> data) :
+			data(data)
+	{}
+
+	bool empty()const noexcept{
+		return this->pos == this->data.size();
+	}
+
+	uint8_t read_byte(){
+		if(this->empty()){
+			throw std::invalid_argument("input log is truncated");
+		}
+		return this->data[this->pos++];
+	}
+
+	uint64_t read_varint(){
+		uint64_t ret = 0;
+		for(unsigned shift = 0; shift < 64; shift += 7){
+			uint8_t b = this->read_byte();
+			ret |= uint64_t(b & 0x7f) << shift;
+			if((b & 0x80) == 0){
+				return ret;
+			}
+		}
+		throw std::invalid_argument("input log is malformed: too long varint");
+	}
+
+	float read_float(){
+		uint32_t v = 0;
+		for(unsigned i = 0; i != 4; ++i){
+			v |= uint32_t(this->read_byte()) << (i * 8);
+		}
+		float f;
+		std::memcpy(&f, &v, sizeof(f));
+		return f;
+	}
+};
+
+morda::mouse_button read_mouse_button(reader& r){
+	auto b = r.read_byte();
+	if(b >= unsigned(morda::mouse_button::enum_size)){
+		throw std::invalid_argument("input log is malformed: unknown mouse button");
+	}
+	return morda::mouse_button(b);
+}
+
+morda::key read_key(reader& r){
+	auto k = r.read_varint();
+	if(k >= unsigned(morda::key::enum_size)){
+		throw std::invalid_argument("input log is malformed: unknown key");
+	}
+	return morda::key(k);
+}
+}
+
+void mordavokne::encode_input_event(std::vector<uint8_t>& buf, const input_event& e, std::chrono::microseconds prev_time){
+	buf.push_back(uint8_t(e.t));
+	write_varint(buf, uint64_t(std::max(e.time - prev_time, std::chrono::microseconds::zero()).count()));
+
+	switch(e.t){
+		case input_event::type::frame:
+			break;
+		case input_event::type::mouse_move:
+			write_float(buf, e.pos.x());
+			write_float(buf, e.pos.y());
+			write_varint(buf, e.pointer_id);
+			break;
+		case input_event::type::mouse_button:
+			buf.push_back(e.is_down ? 1 : 0);
+			write_float(buf, e.pos.x());
+			write_float(buf, e.pos.y());
+			buf.push_back(uint8_t(e.button));
+			write_varint(buf, e.pointer_id);
+			break;
+		case input_event::type::mouse_hover:
+			buf.push_back(e.is_down ? 1 : 0);
+			write_varint(buf, e.pointer_id);
+			break;
+		case input_event::type::key:
+			buf.push_back(e.is_down ? 1 : 0);
+			write_varint(buf, unsigned(e.key));
+			break;
+		case input_event::type::character_input:
+			write_varint(buf, unsigned(e.key));
+			write_varint(buf, e.chars.size());
+			for(auto c : e.chars){
+				write_varint(buf, uint32_t(c));
+			}
+			break;
+		case input_event::type::window_rect:
+			write_float(buf, float(e.rect.p.x()));
+			write_float(buf, float(e.rect.p.y()));
+			write_float(buf, float(e.rect.d.x()));
+			write_float(buf, float(e.rect.d.y()));
+			break;
+		default:
+			ASSERT(false)
+			break;
+	}
+}
+
+std::vector<input_event> mordavokne::decode_input_log(utki::span<const uint8_t> data){
+	if(data.size() < signature.size() + 1 || !std::equal(signature.begin(), signature.end(), data.begin())){
+		throw std::invalid_argument("not an input log");
+	}
+	if(data[signature.size()] != format_version){
+		throw std::invalid_argument("unsupported input log format version");
+	}
+
+	reader r(data.subspan(signature.size() + 1));
+
+	std::vector<input_event> ret;
+	std::chrono::microseconds time(0);
+
+	while(!r.empty()){
+		input_event e;
+
+		auto t = r.read_byte();
+		if(t >= uint8_t(input_event::type::enum_size)){
+			throw std::invalid_argument("input log is malformed: unknown event type");
+		}
+		e.t = input_event::type(t);
+
+		time += std::chrono::microseconds(r.read_varint());
+		e.time = time;
+
+		switch(e.t){
+			case input_event::type::frame:
+				break;
+			case input_event::type::mouse_move:
+				e.pos.x() = r.read_float();
+				e.pos.y() = r.read_float();
+				e.pointer_id = unsigned(r.read_varint());
+				break;
+			case input_event::type::mouse_button:
+				e.is_down = r.read_byte() != 0;
+				e.pos.x() = r.read_float();
+				e.pos.y() = r.read_float();
+				e.button = read_mouse_button(r);
+				e.pointer_id = unsigned(r.read_varint());
+				break;
+			case input_event::type::mouse_hover:
+				e.is_down = r.read_byte() != 0;
+				e.pointer_id = unsigned(r.read_varint());
+				break;
+			case input_event::type::key:
+				e.is_down = r.read_byte() != 0;
+				e.key = read_key(r);
+				break;
+			case input_event::type::character_input:
+				{
+					e.key = read_key(r);
+					auto size = r.read_varint();
+					for(uint64_t i = 0; i != size; ++i){
+						e.chars.push_back(char32_t(r.read_varint()));
+					}
+				}
+				break;
+			case input_event::type::window_rect:
+				e.rect.p.x() = morda::real(r.read_float());
+				e.rect.p.y() = morda::real(r.read_float());
+				e.rect.d.x() = morda::real(r.read_float());
+				e.rect.d.y() = morda::real(r.read_float());
+				break;
+			default:
+				ASSERT(false)
+				break;
+		}
+
+		ret.push_back(std::move(e));
+	}
+
+	return ret;
+}
+
+namespace{
+class input_recorder : public utki::destructable{
+	papki::fs_file file;
+
+	std::vector<uint8_t> buf;
+
+	const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+	std::chrono::microseconds prev_time = std::chrono::microseconds::zero();
+
+	// write the buffered events to the file when buffer grows bigger than that
+	const size_t flush_threshold = 0x10000;
+
+public:
+	input_recorder(const std::string& file_name) :
+			file(file_name)
+	{
+		this->file.open(papki::file::mode::create);
+
+		this->buf.insert(this->buf.end(), signature.begin(), signature.end());
+		this->buf.push_back(format_version);
+	}
+
+	~input_recorder()noexcept{
+		try{
+			this->flush();
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "input_recorder: writing input log failed: " << e.what() << std::endl;})
+		}
+		this->file.close();
+	}
+
+	void flush(){
+		this->file.write(utki::make_span(this->buf));
+		this->buf.clear();
+	}
+
+	void record(input_event& e){
+		e.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->start_time);
+		encode_input_event(this->buf, e, this->prev_time);
+		this->prev_time = e.time;
+
+		if(this->buf.size() >= this->flush_threshold){
+			this->flush();
+		}
+	}
+};
+
+class input_replayer : public morda::updateable{
+	std::vector<input_event> events;
+	size_t next_event = 0;
+
+	bool max_speed;
+
+	std::function<void(const input_event&)> replay;
+
+	std::chrono::steady_clock::time_point start_time;
+
+	std::function<void()> finished;
+
+	morda::context& context;
+
+public:
+	input_replayer(
+			std::vector<input_event>&& events,
+			bool max_speed,
+			std::function<void(const input_event&)>&& replay,
+			std::function<void()>&& finished,
+			morda::context& context
+		) :
+			events(std::move(events)),
+			max_speed(max_speed),
+			replay(std::move(replay)),
+			start_time(std::chrono::steady_clock::now()),
+			finished(std::move(finished)),
+			context(context)
+	{}
+
+	void update(uint32_t dt)override{
+		if(this->max_speed){
+			// replay events of one recorded frame per main loop cycle
+			for(; this->next_event != this->events.size(); ++this->next_event){
+				auto& e = this->events[this->next_event];
+				if(e.t == input_event::type::frame){
+					++this->next_event;
+					break;
+				}
+				this->replay(e);
+			}
+		}else{
+			auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - this->start_time);
+			for(; this->next_event != this->events.size(); ++this->next_event){
+				auto& e = this->events[this->next_event];
+				if(e.time > now){
+					break;
+				}
+				if(e.t != input_event::type::frame){
+					this->replay(e);
+				}
+			}
+		}
+
+		if(this->next_event == this->events.size()){
+			this->context.updater->stop(*this);
+			if(this->finished){
+				// call it later, it might destroy this replayer
+				this->context.run_from_ui_thread(std::move(this->finished));
+				this->finished = nullptr;
+			}
+		}
+	}
+};
+}
+
+void mordavokne::record_input(application& app, input_event&& e){
+	if(!app.input_recorder_pimpl){
+		return;
+	}
+	ASSERT(dynamic_cast<input_recorder*>(app.input_recorder_pimpl.get()))
+	static_cast<input_recorder&>(*app.input_recorder_pimpl).record(e);
+}
+
+void application::record_frame(){
+	input_event e;
+	e.t = input_event::type::frame;
+	record_input(*this, std::move(e));
+}
+
+void application::start_input_recording(const std::string& file_name){
+	this->input_recorder_pimpl.reset();
+	this->input_recorder_pimpl = std::make_unique<input_recorder>(file_name);
+
+	// record initial window rectangle, so that the replay starts with the same viewport
+	input_event e;
+	e.t = input_event::type::window_rect;
+	e.rect = this->curWinRect;
+	record_input(*this, std::move(e));
+}
+
+void application::stop_input_recording(){
+	this->input_recorder_pimpl.reset();
+}
+
+void application::replay_input(const input_event& e){
+	switch(e.t){
+		case input_event::type::mouse_move:
+			this->handle_mouse_move(e.pos, e.pointer_id);
+			break;
+		case input_event::type::mouse_button:
+			this->handle_mouse_button(e.is_down, e.pos, e.button, e.pointer_id);
+			break;
+		case input_event::type::mouse_hover:
+			this->handleMouseHover(e.is_down, e.pointer_id);
+			break;
+		case input_event::type::key:
+			this->handle_key_event(e.is_down, e.key);
+			break;
+		case input_event::type::character_input:
+			{
+				u32string_provider provider(e.chars);
+
+				this->handle_character_input(provider, e.key);
+			}
+			break;
+		case input_event::type::window_rect:
+			this->update_window_rect(e.rect);
+			break;
+		default:
+			break;
+	}
+}
+
+void application::start_input_replay(const std::string& file_name, bool max_speed, std::function<void()>&& finished){
+	this->stop_input_replay();
+
+	papki::fs_file fi(file_name);
+	auto events = decode_input_log(utki::make_span(fi.load()));
+
+	auto replayer = std::make_shared<input_replayer>(
+			std::move(events),
+			max_speed,
+			[this](const input_event& e){
+				this->replay_input(e);
+			},
+			std::move(finished),
+			*this->gui.context
+		);
+
+	this->gui.context->updater->start(replayer, 0);
+
+	this->input_replayer = std::move(replayer);
+}
+
+void application::stop_input_replay(){
+	if(!this->input_replayer){
+		return;
+	}
+	if(this->input_replayer->is_updating()){
+		this->gui.context->updater->stop(*this->input_replayer);
+	}
+	this->input_replayer.reset();
+}
+
+bool application::is_input_replaying()const noexcept{
+	return this->input_replayer && this->input_replayer->is_updating();
+}
@@ -0,0 +1,124 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../application.hpp"
+
+namespace mordavokne{
+
+/**
+ * @brief Recorded input event.
+ * Input log file format:
+ * - 8 bytes signature "MRDVINPT";
+ * - 1 byte format version;
+ * - sequence of events.
+ *
+ * Each event is:
+ * - 1 byte event type;
+ * - time since previous event in microseconds, as unsigned LEB128 varint;
+ * - event type specific payload, floats are 4 bytes little-endian IEEE 754,
+ *   integers are unsigned LEB128 varints, booleans are 1 byte.
+ */
+struct input_event{
+	enum class type{
+		// end of frame, i.e. the buffer swap, no payload
+		frame,
+
+		// pos.x, pos.y, pointer_id
+		mouse_move,
+
+		// is_down, pos.x, pos.y, button, pointer_id
+		mouse_button,
+
+		// is_down (hovered), pointer_id
+		mouse_hover,
+
+		// is_down, key
+		key,
+
+		// key, number of chars, chars
+		character_input,
+
+		// rect.p.x, rect.p.y, rect.d.x, rect.d.y
+		window_rect,
+
+		enum_size
+	};
+
+	type t;
+
+	// time since the recording start
+	std::chrono::microseconds time;
+
+	r4::vector2<float> pos;
+	unsigned pointer_id = 0;
+	bool is_down = false;
+	morda::mouse_button button = morda::mouse_button::left;
+	morda::key key = morda::key::unknown;
+	std::u32string chars;
+	morda::rectangle rect;
+};
+
+/**
+ * @brief Input string provider holding the characters to deliver.
+ * Used to deliver character input which comes not from the windowing system, i.e. replayed or injected.
+ */
+class u32string_provider : public morda::gui::input_string_provider{
+	const std::u32string& chars;
+public:
+	u32string_provider(const std::u32string& chars) :
+			chars(chars)
+	{}
+
+	std::u32string get()const override{
+		return this->chars;
+	}
+};
+
+/**
+ * @brief Encode input event.
+ * @param buf - buffer to append the encoded event to.
+ * @param e - event to encode.
+ * @param prev_time - time of the previous event.
+ */
+void encode_input_event(std::vector<uint8_t>& buf, const input_event& e, std::chrono::microseconds prev_time);
+
+/**
+ * @brief Decode input log.
+ * @param data - contents of the input log file.
+ * @return Decoded events.
+ * @throw std::invalid_argument - in case the data is not a valid input log.
+ */
+std::vector<input_event> decode_input_log(utki::span<const uint8_t> data);
+
+/**
+ * @brief Record input event if input recording is active.
+ * @param app - application.
+ * @param e - event to record, the time field is set by this function.
+ */
+void record_input(application& app, input_event&& e);
+
+}
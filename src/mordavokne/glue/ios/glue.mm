@@ -14,6 +14,7 @@ using namespace mordavokne;
 
 #include "../unix_common.cxx"
 #include "../friend_accessors.cxx"
+#include "../shared_gl_context.hxx"
 
 @interface AppDelegate : UIResponder <UIApplicationDelegate>{
 	application* app;
@@ -177,6 +178,8 @@ namespace{
 }
 
 - (void)glkView:(GLKView *)view drawInRect:(CGRect)rect{
+	// GLKView always presents the drawable after this call, so the frame has to be rendered
+	mordavokne::inst().invalidate();
 	render(mordavokne::inst());
 }
 
@@ -333,6 +336,9 @@ application::application(std::string&& name, const window_params& wp) :
 			)),
 		storage_dir("") //TODO: initialize to proper value
 {
+	this->present_mode_v = wp.present_mode_request;
+	this->max_fps = wp.max_fps;
+
 	this->set_fullscreen(false);//this will intialize the viewport
 }
 
@@ -340,6 +346,21 @@ void application::swap_frame_buffers(){
 	//do nothing
 }
 
+void application::set_present_mode(window_params::present_mode mode){
+	// GLKViewController always synchronizes presentation with the display refresh
+	this->present_mode_v = mode;
+}
+
+unsigned application::get_buffer_age(){
+	return 0;
+}
+
+std::unique_ptr<shared_gl_context> application::create_shared_gl_context(){
+	// EAGLContext can share objects via its EAGLSharegroup, but OpenGL ES is deprecated on iOS, so the loader
+	// context is not implemented for the EAGL based glue, resources are loaded on the UI thread.
+	return nullptr;
+}
+
 void application::show_virtual_keyboard()noexcept{
 	//TODO:
 }
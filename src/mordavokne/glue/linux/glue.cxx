@@ -21,10 +21,11 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <array>
+#include <future>
+#include <thread>
 
 #include <opros/wait_set.hpp>
 #include <papki/fs_file.hpp>
-#include <nitki/queue.hpp>
 
 #include <utki/unicode.hpp>
 #include <utki/string.hpp>
@@ -33,6 +34,14 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <X11/Xutil.h>
 #include <X11/cursorfont.h>
 
+#ifdef MORDAVOKNE_WINDOW_XCB
+#	include <bitset>
+#	include <cstring>
+#	include <X11/XKBlib.h>
+#	include <X11/Xlib-xcb.h>
+#	include <xcb/xcb.h>
+#endif
+
 #ifdef MORDAVOKNE_RENDER_OPENGL
 #	include <GL/glew.h>
 #	include <GL/glx.h>
@@ -41,6 +50,7 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
 #	include <EGL/egl.h>
+#	include <EGL/eglext.h>
 #	include <GLES2/gl2.h>
 #	ifdef MORDAVOKNE_RASPBERRYPI
 #		include <bcm_host.h>
@@ -53,11 +63,23 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 #include "../../application.hpp"
+#include "../../startup.hpp"
 
 #include "../util.hxx"
+#include "../frame_pacer.hxx"
+#include "../message_queue.hxx"
+#include "../program_cache.hxx"
+#include "../shared_gl_context.hxx"
 
 #include "../friend_accessors.cxx"
 #include "../unix_common.cxx"
+#include "key_code_map.cxx"
+
+#ifdef MORDAVOKNE_RENDER_OPENGL
+#	include "glx_probe_cache.cxx"
+#else
+#	include "../egl_shared_context.cxx"
+#endif
 
 using namespace mordavokne;
 
@@ -83,14 +105,42 @@ const std::map<morda::mouse_cursor, unsigned> x_cursor_map = {
 
 namespace{
 struct window_wrapper : public utki::destructable{
+	// Storage directory initialization does not depend on anything else, so in parallel startup mode
+	// it runs on a helper thread from the very beginning. Otherwise it is deferred till requested.
+	std::shared_future<std::string> storage_dir;
+
+#ifdef MORDAVOKNE_RENDER_OPENGL
+	// Contents of the GLX probe cache file, read on the storage directory helper thread in parallel startup mode.
+	std::shared_future<std::vector<std::string>> glx_probe_cache_lines;
+#endif
+
 	struct display_wrapper{
 		Display* display;
 
-		display_wrapper(){
+#ifdef MORDAVOKNE_WINDOW_XCB
+		// Xlib is still needed for GLX/EGL, XIM and cursors, but all the window management
+		// requests and event handling go through XCB.
+		xcb_connection_t* connection;
+#endif
+
+		display_wrapper(bool multithreaded){
+			startup::scope startup_scope("XOpenDisplay");
+
+			if(multithreaded){
+				// Xlib is used from helper threads (input method setup, background loader), so it has to be thread safe
+				if(!XInitThreads()){
+					throw std::runtime_error("XInitThreads() failed");
+				}
+			}
+
 			this->display = XOpenDisplay(0);
 			if(!this->display){
 				throw std::runtime_error("XOpenDisplay() failed");
 			}
+#ifdef MORDAVOKNE_WINDOW_XCB
+			this->connection = XGetXCBConnection(this->display);
+			XSetEventQueueOwner(this->display, XCBOwnsEventQueue);
+#endif
 		}
 
 		~display_wrapper(){
@@ -98,10 +148,61 @@ struct window_wrapper : public utki::destructable{
 		}
 	} display;
 
+	// X atoms used by the window, resolved once in a single server round-trip
+	struct atoms_wrapper{
+		Atom wm_protocols;
+		Atom wm_delete_window;
+		Atom net_wm_state;
+		Atom net_wm_state_fullscreen;
+
+		atoms_wrapper(const display_wrapper& display){
+			startup::scope startup_scope("intern atoms");
+
+			std::array<const char*, 4> names = {{
+				"WM_PROTOCOLS",
+				"WM_DELETE_WINDOW",
+				"_NET_WM_STATE",
+				"_NET_WM_STATE_FULLSCREEN"
+			}};
+			std::array<Atom, names.size()> atoms;
+
+#ifdef MORDAVOKNE_WINDOW_XCB
+			// send all the requests first and only then wait for the replies
+			std::array<xcb_intern_atom_cookie_t, names.size()> cookies;
+			for(size_t i = 0; i != names.size(); ++i){
+				cookies[i] = xcb_intern_atom(display.connection, 0, uint16_t(strlen(names[i])), names[i]);
+			}
+			for(size_t i = 0; i != names.size(); ++i){
+				xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(display.connection, cookies[i], nullptr);
+				if(!reply){
+					throw std::runtime_error("xcb_intern_atom() failed");
+				}
+				atoms[i] = reply->atom;
+				free(reply);
+			}
+#else
+			if(!XInternAtoms(display.display, const_cast<char**>(names.data()), int(names.size()), False, atoms.data())){
+				throw std::runtime_error("XInternAtoms() failed");
+			}
+#endif
+
+			this->wm_protocols = atoms[0];
+			this->wm_delete_window = atoms[1];
+			this->net_wm_state = atoms[2];
+			this->net_wm_state_fullscreen = atoms[3];
+		}
+	} atoms;
+
 	Colormap color_map;
 	::Window window;
 #ifdef MORDAVOKNE_RENDER_OPENGL
 	GLXContext glContext;
+
+	// shares objects with glContext, used by the background loader thread, null if not created
+	GLXContext loader_context = NULL;
+
+	// off-screen drawable for making the loader context current, so that the window is not current in two threads
+	GLXPbuffer loader_pbuffer = None;
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
 #	ifdef MORDAVOKNE_RASPBERRYPI
 	EGL_DISPMANX_WINDOW_T rpiNativeWindow;
@@ -110,11 +211,49 @@ struct window_wrapper : public utki::destructable{
 	DISPMANX_ELEMENT_HANDLE_T rpiDispmanElement;
 #	endif
 	EGLDisplay eglDisplay;
+	EGLConfig eglConfig;
 	EGLSurface eglSurface;
 	EGLContext eglContext;
 #else
 #	error "Unknown graphics API"
 #endif
+
+#ifdef MORDAVOKNE_RENDER_OPENGL
+	PFNGLXSWAPINTERVALEXTPROC swap_interval_ext = nullptr;
+	PFNGLXSWAPINTERVALMESAPROC swap_interval_mesa = nullptr;
+#endif
+
+	// whether negative swap intervals are supported (GLX_EXT_swap_control_tear)
+	bool swap_control_tear_supported = false;
+
+	void set_present_mode(window_params::present_mode mode){
+		int interval = get_swap_interval(mode, this->swap_control_tear_supported);
+
+#ifdef MORDAVOKNE_RENDER_OPENGL
+		if(this->swap_interval_ext){
+			this->swap_interval_ext(this->display.display, this->window, interval);
+		}else if(this->swap_interval_mesa){
+			if(this->swap_interval_mesa(unsigned(std::max(interval, 0))) != 0){
+				throw std::runtime_error("glXSwapIntervalMESA() failed");
+			}
+		}
+#elif defined(MORDAVOKNE_RENDER_OPENGLES)
+		if(eglSwapInterval(this->eglDisplay, std::max(interval, 0)) != EGL_TRUE){
+			throw std::runtime_error("eglSwapInterval() failed");
+		}
+#else
+#	error "Unknown graphics API"
+#endif
+	}
+
+	// whether GLX_EXT_buffer_age or EGL_EXT_buffer_age extension is supported
+	bool buffer_age_supported = false;
+
+#if defined(MORDAVOKNE_RENDER_OPENGLES) && defined(EGL_KHR_swap_buffers_with_damage)
+	// nullptr if neither EGL_KHR_swap_buffers_with_damage nor EGL_EXT_swap_buffers_with_damage is supported
+	PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC eglSwapBuffersWithDamage = nullptr;
+#endif
+
 	struct cursor_wrapper{
 		window_wrapper& owner;
 		Cursor cursor;
@@ -192,12 +331,68 @@ struct window_wrapper : public utki::destructable{
 	XIM inputMethod;
 	XIC inputContext;
 
-	nitki::queue ui_queue;
+	void init_input_method(){
+		startup::scope startup_scope("input method setup");
+
+		this->inputMethod = XOpenIM(this->display.display, NULL, NULL, NULL);
+		if(this->inputMethod == NULL){
+			throw std::runtime_error("XOpenIM() failed");
+		}
+		utki::scope_exit scopeExitInputMethod([this](){
+			XCloseIM(this->inputMethod);
+		});
+
+		this->inputContext = XCreateIC(
+				this->inputMethod,
+				XNClientWindow, this->window,
+				XNFocusWindow, this->window,
+				XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
+				NULL
+			);
+		if(this->inputContext == NULL){
+			throw std::runtime_error("XCreateIC() failed");
+		}
+
+		scopeExitInputMethod.reset();
+	}
+
+	void deinit_input_method()noexcept{
+		XUnsetICFocus(this->inputContext);
+		XDestroyIC(this->inputContext);
+
+		XCloseIM(this->inputMethod);
+	}
+
+	message_queue ui_queue;
+
+	frame_pacer pacer;
 
 	volatile bool quitFlag = false;
 
-	window_wrapper(const window_params& wp){
+	// whether the background loader context is to be created
+	const bool background_loader;
+
+	window_wrapper(const window_params& wp, const std::string& app_name) :
+			storage_dir(std::async(
+					wp.parallel_startup ? std::launch::async : std::launch::deferred,
+					[app_name](){
+						return initialize_storage_dir(app_name);
+					}
+				)),
+#ifdef MORDAVOKNE_RENDER_OPENGL
+			glx_probe_cache_lines(std::async(
+					wp.parallel_startup ? std::launch::async : std::launch::deferred,
+					[storage_dir = this->storage_dir](){
+						return glx_probe_cache::read(storage_dir.get() + glx_probe_cache::file_name);
+					}
+				)),
+#endif
+			display(wp.parallel_startup || wp.background_loader),
+			atoms(this->display),
+			background_loader(wp.background_loader)
+	{
 #ifdef MORDAVOKNE_RENDER_OPENGL
+		startup::scope fb_config_scope("choose FB config");
 		{
 			int glx_ver_major, glx_ver_minor;
 			if(!glXQueryVersion(this->display.display, &glx_ver_major, &glx_ver_minor)){
@@ -213,12 +408,78 @@ struct window_wrapper : public utki::destructable{
 			}
 		}
 
-		GLXFBConfig best_fb_config;
-		{
+		const int screen = DefaultScreen(this->display.display);
+
+		const std::string probe_cache_key = glx_probe_cache::make_key(this->display.display, screen, wp);
+		glx_probe_cache probe_cache;
+		bool probe_cache_valid = false;
+
+		// In parallel startup mode do not wait for the storage directory, if the cache is not read yet, then
+		// probing right away is not slower than waiting. Otherwise, the cache is read synchronously here.
+		if(this->glx_probe_cache_lines.wait_for(std::chrono::seconds(0)) != std::future_status::timeout){
+			probe_cache_valid = probe_cache.load(this->glx_probe_cache_lines.get(), probe_cache_key);
+		}else{
+			LOG([](auto&o){o << "GLX probe cache is not read yet, probing" << std::endl;})
+		}
+		if(!probe_cache_valid){
+			probe_cache = glx_probe_cache();
+			probe_cache.key = probe_cache_key;
+		}
+
+		// the background loader context is made current with a pbuffer
+		const int drawable_type_mask = GLX_WINDOW_BIT | (wp.background_loader ? GLX_PBUFFER_BIT : 0);
+
+		GLXFBConfig best_fb_config = nullptr;
+
+		if(probe_cache_valid){
+			// look up the cached FBConfig directly, all other attributes are ignored when GLX_FBCONFIG_ID is given
+			std::array<int, 3> attribs = {{GLX_FBCONFIG_ID, probe_cache.fb_config_id, None}};
+			int fbcount;
+			GLXFBConfig* fbc = glXChooseFBConfig(this->display.display, screen, attribs.data(), &fbcount);
+			if(fbc){
+				if(fbcount > 0){
+					if(XVisualInfo* vi = glXGetVisualFromFBConfig(this->display.display, fbc[0])){
+						best_fb_config = fbc[0];
+						XFree(vi);
+					}
+				}
+				XFree(fbc);
+			}
+
+			// the FBConfig IDs may be reassigned, e.g. after driver update, so check that the cached one still fits
+			if(best_fb_config){
+				auto get_attrib = [this, &best_fb_config](int attrib){
+					int value = 0;
+					if(glXGetFBConfigAttrib(this->display.display, best_fb_config, attrib, &value) != Success){
+						return -1;
+					}
+					return value;
+				};
+
+				auto drawable_type = get_attrib(GLX_DRAWABLE_TYPE);
+				auto render_type = get_attrib(GLX_RENDER_TYPE);
+				if(get_attrib(GLX_DOUBLEBUFFER) != True
+						|| drawable_type < 0 || (drawable_type & drawable_type_mask) != drawable_type_mask
+						|| render_type < 0 || !(render_type & GLX_RGBA_BIT)
+						|| (wp.buffers.get(window_params::buffer_type::depth) && get_attrib(GLX_DEPTH_SIZE) < 24)
+						|| (wp.buffers.get(window_params::buffer_type::stencil) && get_attrib(GLX_STENCIL_SIZE) < 8)
+					)
+				{
+					best_fb_config = nullptr;
+				}
+			}
+
+			if(!best_fb_config){
+				LOG([](auto&o){o << "cached FBConfig not found or does not match, probing" << std::endl;})
+				probe_cache_valid = false;
+			}
+		}
+
+		if(!best_fb_config){
 			std::vector<int> visualAttribs;
 			visualAttribs.push_back(GLX_X_RENDERABLE); visualAttribs.push_back(True);
 			visualAttribs.push_back(GLX_X_VISUAL_TYPE); visualAttribs.push_back(GLX_TRUE_COLOR);
-			visualAttribs.push_back(GLX_DRAWABLE_TYPE); visualAttribs.push_back(GLX_WINDOW_BIT);
+			visualAttribs.push_back(GLX_DRAWABLE_TYPE); visualAttribs.push_back(drawable_type_mask);
 			visualAttribs.push_back(GLX_RENDER_TYPE); visualAttribs.push_back(GLX_RGBA_BIT);
 			visualAttribs.push_back(GLX_DOUBLEBUFFER);visualAttribs.push_back(True);
 			visualAttribs.push_back(GLX_RED_SIZE); visualAttribs.push_back(8);
@@ -236,7 +497,7 @@ struct window_wrapper : public utki::destructable{
 			visualAttribs.push_back(None);
 
 			int fbcount;
-			GLXFBConfig* fbc = glXChooseFBConfig(this->display.display, DefaultScreen(this->display.display), &*visualAttribs.begin(), &fbcount);
+			GLXFBConfig* fbc = glXChooseFBConfig(this->display.display, screen, &*visualAttribs.begin(), &fbcount);
 			if(!fbc){
 				throw std::runtime_error("glXChooseFBConfig() returned empty list");
 			}
@@ -263,8 +524,13 @@ struct window_wrapper : public utki::destructable{
 				XFree( vi );
 			}
 			best_fb_config = fbc[best_fb_config_index];
+
+			glXGetFBConfigAttrib(this->display.display, best_fb_config, GLX_FBCONFIG_ID, &probe_cache.fb_config_id);
 		}
+		fb_config_scope.end();
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
+		startup::scope egl_config_scope("EGL initialization");
+
 		this->eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 		if(this->eglDisplay == EGL_NO_DISPLAY){
 			throw std::runtime_error("eglGetDisplay(): failed, no matching display connection found");
@@ -279,7 +545,6 @@ struct window_wrapper : public utki::destructable{
 			throw std::runtime_error("eglInitialize() failed");
 		}
 
-		EGLConfig eglConfig;
 		{
 			// TODO: allow stencil and depth configuration etc. via window_params
 			// Here specify the attributes of the desired configuration.
@@ -309,10 +574,13 @@ struct window_wrapper : public utki::destructable{
 		if(eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE){
 			throw std::runtime_error("eglBindApi() failed");
 		}
+		egl_config_scope.end();
 #else
 #	error "Unknown graphics API"
 #endif
 
+		startup::scope window_scope("create window");
+
 		XVisualInfo *visual_info;
 #ifdef MORDAVOKNE_RENDER_OPENGL
 		visual_info = glXGetVisualFromFBConfig(this->display.display, best_fb_config);
@@ -364,6 +632,80 @@ struct window_wrapper : public utki::destructable{
 			XFree(visual_info);
 		});
 
+#ifdef MORDAVOKNE_WINDOW_XCB
+		// the requests are not checked to avoid round-trips, errors are reported asynchronously to the event loop
+		this->color_map = xcb_generate_id(this->display.connection);
+		xcb_create_colormap(
+				this->display.connection,
+				XCB_COLORMAP_ALLOC_NONE,
+				this->color_map,
+				RootWindow(this->display.display, visual_info->screen),
+				visual_info->visualid
+			);
+		utki::scope_exit scopeExitColorMap([this](){
+			xcb_free_colormap(this->display.connection, this->color_map);
+		});
+
+		{
+			// values must go in the order of the value mask bits
+			std::array<uint32_t, 3> values = {{
+				0, // border pixel
+				XCB_EVENT_MASK_EXPOSURE |
+						XCB_EVENT_MASK_KEY_PRESS |
+						XCB_EVENT_MASK_KEY_RELEASE |
+						XCB_EVENT_MASK_BUTTON_PRESS |
+						XCB_EVENT_MASK_BUTTON_RELEASE |
+						XCB_EVENT_MASK_POINTER_MOTION |
+						XCB_EVENT_MASK_BUTTON_MOTION |
+						XCB_EVENT_MASK_STRUCTURE_NOTIFY |
+						XCB_EVENT_MASK_ENTER_WINDOW |
+						XCB_EVENT_MASK_LEAVE_WINDOW,
+				uint32_t(this->color_map)
+			}};
+
+			this->window = xcb_generate_id(this->display.connection);
+			xcb_create_window(
+					this->display.connection,
+					uint8_t(visual_info->depth),
+					this->window,
+					RootWindow(this->display.display, visual_info->screen),
+					0,
+					0,
+					uint16_t(wp.dims.x()),
+					uint16_t(wp.dims.y()),
+					0,
+					XCB_WINDOW_CLASS_INPUT_OUTPUT,
+					visual_info->visualid,
+					XCB_CW_BORDER_PIXEL | XCB_CW_EVENT_MASK | XCB_CW_COLORMAP,
+					values.data()
+				);
+		}
+		utki::scope_exit scopeExitWindow([this](){
+			xcb_destroy_window(this->display.connection, this->window);
+		});
+
+		{ // we want to handle WM_DELETE_WINDOW event to know when window is closed
+			uint32_t a = this->atoms.wm_delete_window;
+			xcb_change_property(
+					this->display.connection,
+					XCB_PROP_MODE_REPLACE,
+					this->window,
+					this->atoms.wm_protocols,
+					XCB_ATOM_ATOM,
+					32,
+					1,
+					&a
+				);
+		}
+
+		xcb_map_window(this->display.connection, this->window);
+
+		xcb_flush(this->display.connection);
+
+		// Make the server not send fake key release events for auto-repeated keys, so that
+		// there is no need to look ahead in the event queue to detect the auto-repeat.
+		XkbSetDetectableAutoRepeat(this->display.display, True, nullptr);
+#else
 		this->color_map = XCreateColormap(
 				this->display.display,
 				RootWindow(this->display.display, visual_info->screen),
@@ -417,31 +759,59 @@ struct window_wrapper : public utki::destructable{
 		});
 
 		{ // we want to handle WM_DELETE_WINDOW event to know when window is closed
-			Atom a = XInternAtom(this->display.display, "WM_DELETE_WINDOW", True);
-			XSetWMProtocols(this->display.display, this->window, &a, 1);
+			XSetWMProtocols(this->display.display, this->window, &this->atoms.wm_delete_window, 1);
 		}
 
 		XMapWindow(this->display.display, this->window);
 
 		XFlush(this->display.display);
+#endif
+
+		window_scope.end();
+
+		// The input method only needs the window, so in parallel startup mode it is set up
+		// on a helper thread while the GL context is being created.
+		std::future<void> input_method_setup = std::async(
+				wp.parallel_startup ? std::launch::async : std::launch::deferred,
+				[this](){
+					this->init_input_method();
+				}
+			);
+		utki::scope_exit scopeExitInputMethodSetup([this, &input_method_setup, parallel = wp.parallel_startup](){
+			// GL context creation has failed, clean up after the helper thread
+			if(!parallel || !input_method_setup.valid()){
+				return;
+			}
+			try{
+				input_method_setup.get();
+				this->deinit_input_method();
+			}catch(...){}
+		});
 
 		//====================
 		// create GLX context
 
+		startup::scope context_scope("create GL context");
+
 #ifdef MORDAVOKNE_RENDER_OPENGL
 		// glXGetProcAddressARB() will retutn non-null pointer even if extension is not supported, so we
 		// need to explicitly check for supported extensions.
 		// SOURCE: https://dri.freedesktop.org/wiki/glXGetProcAddressNeverReturnsNULL/
 
-		auto glx_extensions_string = std::string_view(glXQueryExtensionsString(this->display.display, visual_info->screen));
-		LOG([&](auto&o){o << "glx_extensions_string = " << glx_extensions_string << std::endl;})
+		if(!probe_cache_valid){
+			auto glx_extensions_string = std::string_view(glXQueryExtensionsString(this->display.display, visual_info->screen));
+			LOG([&](auto&o){o << "glx_extensions_string = " << glx_extensions_string << std::endl;})
 
-		auto glx_extensions = utki::split(glx_extensions_string);
+			probe_cache.set_glx_extensions(glx_extensions_string);
+		}
+
+		// creates context which shares objects with the given one
+		auto create_context = [&](GLXContext share_context){
+			if(!probe_cache.has_glx_extension("GLX_ARB_create_context")){
+				// GLX_ARB_create_context is not supported
+				return glXCreateContext(this->display.display, visual_info, share_context, GL_TRUE);
+			}
 
-		if(std::find(glx_extensions.begin(), glx_extensions.end(), "GLX_ARB_create_context") == glx_extensions.end()){
-			// GLX_ARB_create_context is not supported
-			this->glContext = glXCreateContext(this->display.display, visual_info, NULL, GL_TRUE);
-		}else{
 			// GLX_ARB_create_context is supported
 
 			// NOTE: glXGetProcAddressARB() is guaranteed to be present in all GLX versions.
@@ -461,17 +831,32 @@ struct window_wrapper : public utki::destructable{
 
 			auto ver = get_opengl_version_duplet(wp.graphics_api_request);
 
-			static int context_attribs[] = {
+			int context_attribs[] = {
 				GLX_CONTEXT_MAJOR_VERSION_ARB, ver.major,
 				GLX_CONTEXT_MINOR_VERSION_ARB, ver.minor,
 				GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB, // we don't need compatibility context
 				None
 			};
 
-			this->glContext = glXCreateContextAttribsARB(this->display.display, best_fb_config, NULL, GL_TRUE, context_attribs);
+			return glXCreateContextAttribsARB(this->display.display, best_fb_config, share_context, GL_TRUE, context_attribs);
+		};
+
+		this->glContext = create_context(NULL);
+
+		if(wp.background_loader && this->glContext != NULL){
+			// context for the background loader thread, failure to create it is not fatal
+			this->loader_context = create_context(this->glContext);
+			if(this->loader_context){
+				std::array<int, 5> pbuffer_attribs = {{GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None}};
+				this->loader_pbuffer = glXCreatePbuffer(this->display.display, best_fb_config, pbuffer_attribs.data());
+				if(this->loader_pbuffer == None){
+					glXDestroyContext(this->display.display, this->loader_context);
+					this->loader_context = NULL;
+				}
+			}
 		}
 
-		// sync to ensure any errors generated are processed
+		// sync to ensure any errors generated are processed, GLX requests go through Xlib in XCB mode too
 		XSync(this->display.display, False);
 		
 		if(this->glContext == NULL){
@@ -480,47 +865,77 @@ struct window_wrapper : public utki::destructable{
 		utki::scope_exit scopeExitGLContext([this](){
 			glXMakeCurrent(this->display.display, None, NULL);
 			glXDestroyContext(this->display.display, this->glContext);
+			if(this->loader_context){
+				glXDestroyPbuffer(this->display.display, this->loader_pbuffer);
+				glXDestroyContext(this->display.display, this->loader_context);
+			}
 		});
 
 		glXMakeCurrent(this->display.display, this->window, this->glContext);
 
-		//===========================================
-		// disable v-sync via swap control extension
+		context_scope.end();
 
-		if(std::find(glx_extensions.begin(), glx_extensions.end(), "GLX_EXT_swap_control") != glx_extensions.end()){
+		{
+			auto str = [](const GLubyte* s){
+				return s ? std::string(reinterpret_cast<const char*>(s)) : std::string();
+			};
+			auto renderer = str(glGetString(GL_RENDERER));
+			auto version = str(glGetString(GL_VERSION));
+
+			// the driver may have been updated without changing the GLX vendor and version strings
+			if(!probe_cache_valid || renderer != probe_cache.gl_renderer || version != probe_cache.gl_version){
+				probe_cache.gl_renderer = std::move(renderer);
+				probe_cache.gl_version = std::move(version);
+				probe_cache.save(this->storage_dir.get() + glx_probe_cache::file_name);
+			}
+		}
+
+		//============================
+		// get swap control extension
+
+		if(probe_cache.has_glx_extension("GLX_EXT_swap_control")){
 			LOG([](auto&o){o << "GLX_EXT_swap_control is supported\n";})
 
-			auto glXSwapIntervalEXT =
+			this->swap_interval_ext =
 					(PFNGLXSWAPINTERVALEXTPROC)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalEXT");
-			
-			ASSERT(glXSwapIntervalEXT)
 
-			// disable v-sync
-			glXSwapIntervalEXT(this->display.display, this->window, 0);
-		}else if(std::find(glx_extensions.begin(), glx_extensions.end(), "GLX_MESA_swap_control") != glx_extensions.end()){
+			ASSERT(this->swap_interval_ext)
+
+			if(probe_cache.has_glx_extension("GLX_EXT_swap_control_tear")){
+				LOG([](auto&o){o << "GLX_EXT_swap_control_tear is supported\n";})
+				this->swap_control_tear_supported = true;
+			}
+		}else if(probe_cache.has_glx_extension("GLX_MESA_swap_control")){
 			LOG([](auto&o){o << "GLX_MESA_swap_control is supported\n";})
 
-			auto glXSwapIntervalMESA =
+			this->swap_interval_mesa =
 					(PFNGLXSWAPINTERVALMESAPROC)glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalMESA");
-			
-			ASSERT(glXSwapIntervalMESA)
 
-			// disable v-sync
-			if(glXSwapIntervalMESA(0) != 0){
-				throw std::runtime_error("glXSwapIntervalMESA() failed");
-			}
+			ASSERT(this->swap_interval_mesa)
 		}else{
 			std::cout << "none of GLX_EXT_swap_control, GLX_MESA_swap_control GLX extensions are supported";
 		}
 
+		this->set_present_mode(wp.present_mode_request);
+
+#ifdef GLX_EXT_buffer_age
+		if(probe_cache.has_glx_extension("GLX_EXT_buffer_age")){
+			LOG([](auto&o){o << "GLX_EXT_buffer_age is supported\n";})
+			this->buffer_age_supported = true;
+		}
+#endif
+
 		// sync to ensure any errors generated are processed
 		XSync(this->display.display, False);
 
 		//=============
 		// init OpenGL
 
-		if(glewInit() != GLEW_OK){
-			throw std::runtime_error("GLEW initialization failed");
+		{
+			startup::scope startup_scope("glewInit");
+			if(glewInit() != GLEW_OK){
+				throw std::runtime_error("GLEW initialization failed");
+			}
 		}
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
 
@@ -613,9 +1028,37 @@ struct window_wrapper : public utki::destructable{
 			eglDestroyContext(this->eglDisplay, this->eglContext);
 		});
 
-		// disable v-sync
-		if(eglSwapInterval(this->eglDisplay, 0) != EGL_TRUE){
-			throw std::runtime_error("eglSwapInterval() failed");
+		context_scope.end();
+
+		// EGL has no adaptive vsync, negative swap intervals are clamped to the minimum supported interval
+		this->set_present_mode(wp.present_mode_request);
+
+		{
+			auto egl_extensions = utki::split(std::string_view(eglQueryString(this->eglDisplay, EGL_EXTENSIONS)));
+			auto has_extension = [&egl_extensions](std::string_view name){
+				return std::find(egl_extensions.begin(), egl_extensions.end(), name) != egl_extensions.end();
+			};
+
+#	ifdef EGL_EXT_buffer_age
+			if(has_extension("EGL_EXT_buffer_age")){
+				LOG([](auto&o){o << "EGL_EXT_buffer_age is supported\n";})
+				this->buffer_age_supported = true;
+			}
+#	endif
+
+#	ifdef EGL_KHR_swap_buffers_with_damage
+			if(has_extension("EGL_KHR_swap_buffers_with_damage")){
+				LOG([](auto&o){o << "EGL_KHR_swap_buffers_with_damage is supported\n";})
+				this->eglSwapBuffersWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+						eglGetProcAddress("eglSwapBuffersWithDamageKHR")
+					);
+			}else if(has_extension("EGL_EXT_swap_buffers_with_damage")){
+				LOG([](auto&o){o << "EGL_EXT_swap_buffers_with_damage is supported\n";})
+				this->eglSwapBuffersWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+						eglGetProcAddress("eglSwapBuffersWithDamageEXT")
+					);
+			}
+#	endif
 		}
 #else
 #	error "Unknown graphics API"
@@ -624,31 +1067,10 @@ struct window_wrapper : public utki::destructable{
 		//=========================
 		// initialize input method
 
-		this->inputMethod = XOpenIM(this->display.display, NULL, NULL, NULL);
-		if(this->inputMethod == NULL){
-			throw std::runtime_error("XOpenIM() failed");
-		}
-		utki::scope_exit scopeExitInputMethod([this](){
-			XCloseIM(this->inputMethod);
-		});
-
-		this->inputContext = XCreateIC(
-				this->inputMethod,
-				XNClientWindow, this->window,
-				XNFocusWindow, this->window,
-				XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
-				NULL
-			);
-		if(this->inputContext == NULL){
-			throw std::runtime_error("XCreateIC() failed");
-		}
-		utki::scope_exit scopeExitInputContext([this](){
-			XUnsetICFocus(this->inputContext);
-			XDestroyIC(this->inputContext);
-		});
+		// runs the setup if it was deferred, or waits for the helper thread, rethrows its exception if any
+		input_method_setup.get();
 
-		scopeExitInputContext.reset();
-		scopeExitInputMethod.reset();
+		scopeExitInputMethodSetup.reset();
 		scopeExitWindow.reset();
 		scopeExitColorMap.reset();
 #ifdef MORDAVOKNE_RENDER_OPENGL
@@ -663,14 +1085,15 @@ struct window_wrapper : public utki::destructable{
 	}
 
 	~window_wrapper()noexcept{
-		XUnsetICFocus(this->inputContext);
-		XDestroyIC(this->inputContext);
-
-		XCloseIM(this->inputMethod);
+		this->deinit_input_method();
 
 #ifdef MORDAVOKNE_RENDER_OPENGL
 		glXMakeCurrent(this->display.display, None, NULL);
 		glXDestroyContext(this->display.display, this->glContext);
+		if(this->loader_context){
+			glXDestroyPbuffer(this->display.display, this->loader_pbuffer);
+			glXDestroyContext(this->display.display, this->loader_context);
+		}
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
 		eglMakeCurrent(this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 		eglDestroyContext(this->eglDisplay, this->eglContext);
@@ -679,8 +1102,14 @@ struct window_wrapper : public utki::destructable{
 #	error "Unknown graphics API"
 #endif
 
+#ifdef MORDAVOKNE_WINDOW_XCB
+		xcb_destroy_window(this->display.connection, this->window);
+		xcb_free_colormap(this->display.connection, this->color_map);
+		xcb_flush(this->display.connection);
+#else
 		XDestroyWindow(this->display.display, this->window);
 		XFreeColormap(this->display.display, this->color_map);
+#endif
 
 #ifdef MORDAVOKNE_RENDER_OPENGLES
 		eglTerminate(this->eglDisplay);
@@ -697,6 +1126,40 @@ window_wrapper& get_impl(application& app){
 	return getImpl(get_window_pimpl(app));
 }
 
+#ifdef MORDAVOKNE_RENDER_OPENGL
+class glx_shared_context : public shared_gl_context{
+	window_wrapper& ww;
+public:
+	glx_shared_context(window_wrapper& ww) :
+			ww(ww)
+	{}
+
+	void make_current()override{
+		// the context does not render anything, but GLX needs a drawable to make it current
+		if(!glXMakeContextCurrent(this->ww.display.display, this->ww.loader_pbuffer, this->ww.loader_pbuffer, this->ww.loader_context)){
+			throw std::runtime_error("glXMakeContextCurrent() failed for shared context");
+		}
+	}
+
+	void release()noexcept override{
+		glXMakeContextCurrent(this->ww.display.display, None, None, NULL);
+	}
+
+	void wait_for_completion()override{
+		if(GLEW_VERSION_3_2 || GLEW_ARB_sync){
+			GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			if(fence){
+				// wait in chunks of one second, until the commands are completed
+				while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED){}
+				glDeleteSync(fence);
+				return;
+			}
+		}
+		glFinish();
+	}
+};
+#endif
+
 }
 
 namespace{
@@ -719,15 +1182,21 @@ morda::real getDotsPerPt(Display* display){
 
 application::application(std::string&& name, const window_params& wp) :
 		name(name),
-		window_pimpl(std::make_unique<window_wrapper>(wp)),
+		window_pimpl(std::make_unique<window_wrapper>(wp, this->name)),
 		gui(std::make_shared<morda::context>(
+				[this, &wp](){
+					if(wp.program_binary_cache){
+						enable_program_binary_cache(getImpl(this->window_pimpl).storage_dir.get());
+					}
+					startup::scope startup_scope("create renderer");
 #ifdef MORDAVOKNE_RENDER_OPENGL
-				std::make_shared<morda::render_opengl::renderer>(),
+					return std::make_shared<morda::render_opengl::renderer>();
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
-				std::make_shared<morda::render_opengles::renderer>(),
+					return std::make_shared<morda::render_opengles::renderer>();
 #else
 #	error "Unknown graphics API"
 #endif
+				}(),
 				std::make_shared<morda::updater>(),
 				[this](std::function<void()>&& a){
 					getImpl(get_window_pimpl(*this)).ui_queue.push_back(std::move(a));
@@ -739,8 +1208,11 @@ application::application(std::string&& name, const window_params& wp) :
 				getDotsPerInch(getImpl(window_pimpl).display.display),
 				::getDotsPerPt(getImpl(window_pimpl).display.display)
 			)),
-		storage_dir(initialize_storage_dir(this->name))
+		storage_dir(getImpl(window_pimpl).storage_dir.get())
 {
+	this->present_mode_v = wp.present_mode_request;
+	this->max_fps = wp.max_fps;
+
 #ifdef MORDAVOKNE_RASPBERRYPI
 	this->set_fullscreen(true);
 #else
@@ -755,6 +1227,24 @@ application::application(std::string&& name, const window_params& wp) :
 #endif
 }
 
+std::unique_ptr<shared_gl_context> application::create_shared_gl_context(){
+	auto& ww = get_impl(*this);
+
+#ifdef MORDAVOKNE_RENDER_OPENGL
+	if(!ww.loader_context){
+		return nullptr;
+	}
+	return std::make_unique<glx_shared_context>(ww);
+#elif defined(MORDAVOKNE_RENDER_OPENGLES)
+	if(!ww.background_loader){
+		return nullptr;
+	}
+	return std::make_unique<egl_shared_context>(ww.eglDisplay, ww.eglConfig, ww.eglContext);
+#else
+#	error "Unknown graphics API"
+#endif
+}
+
 namespace{
 
 class XEvent_waitable : public opros::waitable{
@@ -794,265 +1284,6 @@ morda::mouse_button buttonNumberToEnum(int number){
 	}
 }
 
-const std::array<morda::key, std::uint8_t(-1) + 1> keyCodeMap = {{
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::escape, // 9
-	morda::key::one, // 10
-	morda::key::two, // 11
-	morda::key::three, // 12
-	morda::key::four, // 13
-	morda::key::five, // 14
-	morda::key::six, // 15
-	morda::key::seven, // 16
-	morda::key::eight, // 17
-	morda::key::nine, // 18
-	morda::key::zero, // 19
-	morda::key::minus, // 20
-	morda::key::equals, // 21
-	morda::key::backspace, // 22
-	morda::key::tabulator, // 23
-	morda::key::q, // 24
-	morda::key::w, // 25
-	morda::key::e, // 26
-	morda::key::r, // 27
-	morda::key::t, // 28
-	morda::key::y, // 29
-	morda::key::u, // 30
-	morda::key::i, // 31
-	morda::key::o, // 32
-	morda::key::p, // 33
-	morda::key::left_square_bracket, // 34
-	morda::key::right_square_bracket, // 35
-	morda::key::enter, // 36
-	morda::key::left_control, // 37
-	morda::key::a, // 38
-	morda::key::s, // 39
-	morda::key::d, // 40
-	morda::key::f, // 41
-	morda::key::g, // 42
-	morda::key::h, // 43
-	morda::key::j, // 44
-	morda::key::k, // 45
-	morda::key::l, // 46
-	morda::key::semicolon, // 47
-	morda::key::apostrophe, // 48
-	morda::key::grave, // 49
-	morda::key::left_shift, // 50
-	morda::key::backslash, // 51
-	morda::key::z, // 52
-	morda::key::x, // 53
-	morda::key::c, // 54
-	morda::key::v, // 55
-	morda::key::b, // 56
-	morda::key::n, // 57
-	morda::key::m, // 58
-	morda::key::comma, // 59
-	morda::key::period, // 60
-	morda::key::slash, // 61
-	morda::key::right_shift, // 62
-	morda::key::unknown,
-	morda::key::left_alt, // 64
-	morda::key::space, // 65
-	morda::key::capslock, // 66
-	morda::key::f1, // 67
-	morda::key::f2, // 68
-	morda::key::f3, // 69
-	morda::key::f4, // 70
-	morda::key::f5, // 71
-	morda::key::f6, // 72
-	morda::key::f7, // 73
-	morda::key::f8, // 74
-	morda::key::f9, // 75
-	morda::key::f10, // 76
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::f11, // 95
-	morda::key::f12, // 96
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::right_control, // 105
-	morda::key::unknown,
-	morda::key::print_screen, // 107
-	morda::key::right_alt, // 108
-	morda::key::unknown,
-	morda::key::home, // 110
-	morda::key::arrow_up, // 111
-	morda::key::page_up, // 112
-	morda::key::arrow_left, // 113
-	morda::key::arrow_right, // 114
-	morda::key::end, // 115
-	morda::key::arrow_down, // 116
-	morda::key::page_down, // 117
-	morda::key::insert, // 118
-	morda::key::deletion, // 119
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::pause, // 127
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::left_command, // 133
-	morda::key::unknown,
-	morda::key::menu, // 135
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown,
-	morda::key::unknown
-}};
-
 class KeyEventUnicodeProvider : public morda::gui::input_string_provider{
 	XIC& xic;
 	XEvent& event;
@@ -1107,6 +1338,29 @@ public:
 	}
 };
 
+#ifdef MORDAVOKNE_WINDOW_XCB
+// Input method functions only accept Xlib events, so convert the XCB key event to Xlib one.
+XEvent to_xlib_key_event(Display* display, const xcb_key_press_event_t& e){
+	XEvent ret;
+	ret.xkey.type = (e.response_type & ~0x80) == XCB_KEY_PRESS ? KeyPress : KeyRelease;
+	ret.xkey.serial = e.sequence;
+	ret.xkey.send_event = (e.response_type & 0x80) ? True : False;
+	ret.xkey.display = display;
+	ret.xkey.window = e.event;
+	ret.xkey.root = e.root;
+	ret.xkey.subwindow = e.child;
+	ret.xkey.time = e.time;
+	ret.xkey.x = e.event_x;
+	ret.xkey.y = e.event_y;
+	ret.xkey.x_root = e.root_x;
+	ret.xkey.y_root = e.root_y;
+	ret.xkey.state = e.state;
+	ret.xkey.keycode = e.detail;
+	ret.xkey.same_screen = e.same_screen;
+	return ret;
+}
+#endif
+
 }
 
 void application::quit()noexcept{
@@ -1127,11 +1381,19 @@ int main(int argc, const char** argv){
 
 	XEvent_waitable xew(ww.display.display);
 
-	opros::wait_set wait_set(2);
+#ifdef MORDAVOKNE_WINDOW_XCB
+	// keys which are currently pressed, used to detect auto-repeated key presses
+	std::bitset<std::uint8_t(-1) + 1> keys_down;
+#endif
+
+	opros::wait_set wait_set(3);
 
 	wait_set.add(xew, {opros::ready::read});
 	wait_set.add(ww.ui_queue, {opros::ready::read});
 
+	// resource watcher is created when the application starts watching resources for the first time, see application::watch_resources()
+	res_watcher* rw = nullptr;
+
 	// Sometimes the first Expose event does not come for some reason. It happens constantly in some systems and never happens on all the others.
 	// So, render everything for the first time.
 	render(*app);
@@ -1139,35 +1401,234 @@ int main(int argc, const char** argv){
 	while(!ww.quitFlag){
 		xew.clear_read_flag(); // clear read flag because we have no 'read' function in XEvent_waitable which would do that for us
 
-		auto num_waitables_triggered = wait_set.wait(app->gui.update());
+		if(!rw){
+			rw = get_res_watcher(*app);
+			if(rw){
+				wait_set.add(*rw, {opros::ready::read});
+			}
+		}
+
+		uint32_t update_timeout = app->gui.update();
+
+		mark_frame_phase(*app, frame_profiler::phase::update);
+
+#ifdef MORDAVOKNE_WINDOW_XCB
+		// send out all the requests queued by XCB as well as by Xlib (cursors, GLX)
+		XFlush(ww.display.display);
+#endif
+
+		ww.pacer.set_target(*app);
+
+		uint32_t timeout = update_timeout;
+		if(needs_render(*app)){
+			// there is a frame to render, wake up in time for the frame deadline
+			timeout = std::min(timeout, ww.pacer.get_wait_timeout());
+		}
+		if(is_readback_pending(*app)){
+			// captured frames are to be delivered on the next main loop cycle, which is subject to frame pacing
+			timeout = ww.pacer.is_enabled() ? std::min(timeout, ww.pacer.get_wait_timeout()) : 0;
+		}
+
+#ifdef MORDAVOKNE_WINDOW_XCB
+		// Events could have been read from the socket into the XCB's queue while waiting for some reply,
+		// e.g. during the buffer swap. The socket will not become ready for those, so do not wait then.
+		xcb_generic_event_t* queued_event = xcb_poll_for_queued_event(ww.display.connection);
+		if(queued_event){
+			timeout = 0;
+		}
+#endif
+
+		auto num_waitables_triggered = wait_set.wait(timeout);
 		// TRACE(<< "num_waitables_triggered = " << num_waitables_triggered << std::endl)
 
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
+		if(num_waitables_triggered == 0 && timeout == update_timeout){
+			// waiting has timed out, this means that it's time to update the updateables, which will change the GUI
+			app->invalidate();
+		}
+
 		bool ui_queue_ready_to_read = ww.ui_queue.flags().get(opros::ready::read);
 		if(ui_queue_ready_to_read){
-			while(auto m = ww.ui_queue.pop_front()){
+			ww.ui_queue.drain([&app](message& m){
+				trace::scope trace_scope("ui_queue message");
+				count_ui_message(*app);
 				TRACE(<< "loop message" << std::endl)
 				m();
-			}
+			});
 			ASSERT(!ww.ui_queue.flags().get(opros::ready::read))
+			app->invalidate();
+		}
+
+		bool resources_changed = rw && rw->flags().get(opros::ready::read);
+		if(resources_changed){
+			rw->handle_changes();
+			app->invalidate();
 		}
 
+		mark_frame_phase(*app, frame_profiler::phase::ui_queue);
+
 		morda::vector2 new_win_dims(-1, -1);
 
 		// NOTE: do not check 'read' flag for X event, for some reason when waiting with 0 timeout it will never be set.
 		//       Maybe some bug in XWindows, maybe something else.
 		bool x_event_arrived = false;
+
+		// squash consecutive mouse motion events into one, for that store the latest pointer position and
+		// send the mouse move only before the next non-motion event or when there are no more pending events
+		bool coalesce_motion = should_coalesce_motion(*app);
+		bool mouse_move_pending = false;
+		morda::vector2 mouse_move_pos;
+		auto flush_mouse_move = [&](){
+			if(!mouse_move_pending){
+				return;
+			}
+			mouse_move_pending = false;
+			handle_mouse_move(*app, mouse_move_pos, 0);
+		};
+
+		// input events carry X server timestamps, which is CLOCK_MONOTONIC in milliseconds
+		auto note_event_time = [&](uint32_t time){
+			if(app->is_input_latency_measurement()){
+				note_input_time(*app, monotonic_ms_to_time_point(time));
+			}
+		};
+
+#ifdef MORDAVOKNE_WINDOW_XCB
+		// xcb_poll_for_event() never blocks, it only reads what has already arrived to the socket
+		for(
+				auto e = queued_event ? queued_event : xcb_poll_for_event(ww.display.connection);
+				e;
+				e = xcb_poll_for_event(ww.display.connection)
+			)
+		{
+			x_event_arrived = true;
+			utki::scope_exit scope_exit_event([e](){
+				free(e);
+			});
+			uint8_t type = e->response_type & ~0x80;
+			if(type != XCB_MOTION_NOTIFY){
+				flush_mouse_move();
+			}
+			switch(type){
+				case 0:
+					{
+						// Requests are not checked, so errors come here. Those are errors of single requests,
+						// e.g. setting a cursor, so they are not fatal.
+						auto& err = *reinterpret_cast<xcb_generic_error_t*>(e);
+						LOG([&](auto&o){
+							o << "X error: code = " << unsigned(err.error_code)
+									<< ", request = " << unsigned(err.major_code) << "." << unsigned(err.minor_code)
+									<< std::endl;
+						})
+					}
+					break;
+				case XCB_EXPOSE:
+					if(reinterpret_cast<xcb_expose_event_t*>(e)->count != 0){
+						break;
+					}
+					// the frame will be rendered after all pending events are handled
+					app->invalidate();
+					break;
+				case XCB_CONFIGURE_NOTIFY:
+					// squash all window resize events into one, same as for Xlib
+					{
+						auto& ce = *reinterpret_cast<xcb_configure_notify_event_t*>(e);
+						new_win_dims.x() = morda::real(ce.width);
+						new_win_dims.y() = morda::real(ce.height);
+					}
+					break;
+				case XCB_KEY_PRESS:
+					{
+						auto& ke = *reinterpret_cast<xcb_key_press_event_t*>(e);
+						note_event_time(ke.time);
+						morda::key key = keyCodeMap[ke.detail];
+						XEvent xe = to_xlib_key_event(ww.display.display, ke);
+
+						// with detectable auto-repeat the auto-repeated key comes as a repeated key press without release
+						if(!keys_down.test(ke.detail)){
+							keys_down.set(ke.detail);
+							handle_key_event(*app, true, key);
+						}
+						handle_character_input(*app, KeyEventUnicodeProvider(ww.inputContext, xe), key);
+					}
+					break;
+				case XCB_KEY_RELEASE:
+					{
+						auto& ke = *reinterpret_cast<xcb_key_release_event_t*>(e);
+						note_event_time(ke.time);
+						keys_down.reset(ke.detail);
+						handle_key_event(*app, false, keyCodeMap[ke.detail]);
+					}
+					break;
+				case XCB_BUTTON_PRESS:
+				case XCB_BUTTON_RELEASE:
+					{
+						auto& be = *reinterpret_cast<xcb_button_press_event_t*>(e);
+						note_event_time(be.time);
+						handle_mouse_button(
+								*app,
+								type == XCB_BUTTON_PRESS,
+								morda::vector2(be.event_x, be.event_y),
+								buttonNumberToEnum(be.detail),
+								0
+							);
+					}
+					break;
+				case XCB_MOTION_NOTIFY:
+					{
+						auto& me = *reinterpret_cast<xcb_motion_notify_event_t*>(e);
+						note_event_time(me.time);
+						morda::vector2 pos(me.event_x, me.event_y);
+						if(coalesce_motion){
+							mouse_move_pending = true;
+							mouse_move_pos = pos;
+							break;
+						}
+						handle_mouse_move(*app, pos, 0);
+					}
+					break;
+				case XCB_ENTER_NOTIFY:
+					handleMouseHover(*app, true, 0);
+					break;
+				case XCB_LEAVE_NOTIFY:
+					handleMouseHover(*app, false, 0);
+					break;
+				case XCB_CLIENT_MESSAGE:
+					{
+						auto& cm = *reinterpret_cast<xcb_client_message_event_t*>(e);
+						if(cm.type == ww.atoms.wm_protocols && cm.data.data32[0] == ww.atoms.wm_delete_window){
+							ww.quitFlag = true;
+						}
+					}
+					break;
+				default:
+					// ignore
+					break;
+			}
+		}
+		flush_mouse_move();
+
+		if(xcb_connection_has_error(ww.display.connection)){
+			throw std::runtime_error("connection to X server is broken");
+		}
+#else
 		while(XPending(ww.display.display) > 0){
 			x_event_arrived = true;
 			XEvent event;
 			XNextEvent(ww.display.display, &event);
 			// TRACE(<< "X event got, type = " << (event.type) << std::endl)
+			if(event.type != MotionNotify){
+				flush_mouse_move();
+			}
 			switch(event.type){
 				case Expose:
 //						TRACE(<< "Expose X event got" << std::endl)
 					if(event.xexpose.count != 0){
 						break;
 					}
-					render(*app);
+					// the frame will be rendered after all pending events are handled
+					app->invalidate();
 					break;
 				case ConfigureNotify:
 //						TRACE(<< "ConfigureNotify X event got" << std::endl)
@@ -1179,6 +1640,7 @@ int main(int argc, const char** argv){
 				case KeyPress:
 //						TRACE(<< "KeyPress X event got" << std::endl)
 					{
+						note_event_time(uint32_t(event.xkey.time));
 						morda::key key = keyCodeMap[std::uint8_t(event.xkey.keycode)];
 						handle_key_event(*app, true, key);
 						handle_character_input(*app, KeyEventUnicodeProvider(ww.inputContext, event), key);
@@ -1187,6 +1649,7 @@ int main(int argc, const char** argv){
 				case KeyRelease:
 //						TRACE(<< "KeyRelease X event got" << std::endl)
 					{
+						note_event_time(uint32_t(event.xkey.time));
 						morda::key key = keyCodeMap[std::uint8_t(event.xkey.keycode)];
 
 						// detect auto-repeated key events
@@ -1213,6 +1676,7 @@ int main(int argc, const char** argv){
 				case ButtonPress:
 					// LOG([&](auto&o){o << "ButtonPress X event got, button mask = " << event.xbutton.button << std::endl;})
 					// LOG([&](auto&o){o << "ButtonPress X event got, x, y = " << event.xbutton.x << ", " << event.xbutton.y << std::endl;})
+					note_event_time(uint32_t(event.xbutton.time));
 					handle_mouse_button(
 							*app,
 							true,
@@ -1223,6 +1687,7 @@ int main(int argc, const char** argv){
 					break;
 				case ButtonRelease:
 					// LOG([&](auto&o){o << "ButtonRelease X event got, button mask = " << event.xbutton.button << std::endl;})
+					note_event_time(uint32_t(event.xbutton.time));
 					handle_mouse_button(
 							*app,
 							false,
@@ -1233,6 +1698,12 @@ int main(int argc, const char** argv){
 					break;
 				case MotionNotify:
 //						TRACE(<< "MotionNotify X event got" << std::endl)
+					note_event_time(uint32_t(event.xmotion.time));
+					if(coalesce_motion){
+						mouse_move_pending = true;
+						mouse_move_pos = morda::vector2(event.xmotion.x, event.xmotion.y);
+						break;
+					}
 					handle_mouse_move(
 							*app,
 							morda::vector2(event.xmotion.x, event.xmotion.y),
@@ -1247,13 +1718,11 @@ int main(int argc, const char** argv){
 					break;
 				case ClientMessage:
 //						TRACE(<< "ClientMessage X event got" << std::endl)
-					// probably a WM_DELETE_WINDOW event
+					if(event.xclient.message_type == ww.atoms.wm_protocols
+							&& Atom(event.xclient.data.l[0]) == ww.atoms.wm_delete_window
+						)
 					{
-						char* name = XGetAtomName(ww.display.display, event.xclient.message_type);
-						if(*name == *"WM_PROTOCOLS"){
-							ww.quitFlag = true;
-						}
-						XFree(name);
+						ww.quitFlag = true;
 					}
 					break;
 				default:
@@ -1261,11 +1730,13 @@ int main(int argc, const char** argv){
 					break;
 			}
 		}
+		flush_mouse_move();
+#endif
 
 		// WORKAROUND: XEvent file descriptor becomes ready to read many times per second, even if
 		//             there are no events to handle returned by XPending(), so here we check if something
 		//             meaningful actually happened and call render() only if it did
-		if(num_waitables_triggered != 0 && !x_event_arrived && !ui_queue_ready_to_read){
+		if(num_waitables_triggered != 0 && !x_event_arrived && !ui_queue_ready_to_read && !resources_changed){
 			continue;
 		}
 
@@ -1273,9 +1744,21 @@ int main(int argc, const char** argv){
 			update_window_rect(*app, morda::rectangle(0, new_win_dims));
 		}
 
+		mark_frame_phase(*app, frame_profiler::phase::events);
+
+		if(needs_render(*app) && !ww.pacer.start_frame()){
+			// it is too early for the next frame, it will be rendered after waiting till the frame deadline
+			continue;
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
 		render(*app);
 	}
 
+	if(rw){
+		wait_set.remove(*rw);
+	}
 	wait_set.remove(ww.ui_queue);
 	wait_set.remove(xew);
 
@@ -1294,21 +1777,37 @@ void application::set_fullscreen(bool enable){
 
 	auto& ww = getImpl(this->window_pimpl);
 
-	XEvent event;
-	Atom stateAtom;
-	Atom atom;
+#ifdef MORDAVOKNE_WINDOW_XCB
+	xcb_client_message_event_t event;
+	memset(&event, 0, sizeof(event));
+	event.response_type = XCB_CLIENT_MESSAGE;
+	event.format = 32;
+	event.window = ww.window;
+	event.type = ww.atoms.net_wm_state;
+	event.data.data32[0] = enable ? 1 : 0;
+	event.data.data32[1] = ww.atoms.net_wm_state_fullscreen;
+	event.data.data32[2] = 0;
+
+	xcb_send_event(
+			ww.display.connection,
+			0,
+			DefaultRootWindow(ww.display.display),
+			XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY,
+			reinterpret_cast<const char*>(&event)
+		);
 
-	stateAtom = XInternAtom(ww.display.display, "_NET_WM_STATE", False);
-	atom = XInternAtom(ww.display.display, "_NET_WM_STATE_FULLSCREEN", False);
+	xcb_flush(ww.display.connection);
+#else
+	XEvent event;
 
 	event.xclient.type = ClientMessage;
 	event.xclient.serial = 0;
 	event.xclient.send_event = True;
 	event.xclient.window = ww.window;
-	event.xclient.message_type = stateAtom;
+	event.xclient.message_type = ww.atoms.net_wm_state;
 	event.xclient.format = 32;
 	event.xclient.data.l[0]	= enable ? 1 : 0;
-	event.xclient.data.l[1]	= atom;
+	event.xclient.data.l[1]	= ww.atoms.net_wm_state_fullscreen;
 	event.xclient.data.l[2]	= 0;
 
 	XSendEvent(
@@ -1320,6 +1819,7 @@ void application::set_fullscreen(bool enable){
 		);
 
 	XFlush(ww.display.display);
+#endif
 
 	this->isFullscreen_v = enable;
 }
@@ -1328,14 +1828,59 @@ void application::set_mouse_cursor_visible(bool visible){
 	get_impl(*this).set_cursor_visible(visible);
 }
 
+void application::set_present_mode(window_params::present_mode mode){
+	get_impl(*this).set_present_mode(mode);
+	this->present_mode_v = mode;
+}
+
 void application::swap_frame_buffers(){
 	auto& ww = getImpl(this->window_pimpl);
 
 #ifdef MORDAVOKNE_RENDER_OPENGL
 	glXSwapBuffers(ww.display.display, ww.window);
 #elif defined(MORDAVOKNE_RENDER_OPENGLES)
+#	ifdef EGL_KHR_swap_buffers_with_damage
+	if(this->frame_is_partial && ww.eglSwapBuffersWithDamage){
+		// damage rectangle is in surface coordinates with origin at bottom left corner, same as GL viewport
+		std::array<EGLint, 4> rect = {{
+			this->frame_damage.p.x(),
+			this->frame_damage.p.y(),
+			this->frame_damage.d.x(),
+			this->frame_damage.d.y()
+		}};
+		ww.eglSwapBuffersWithDamage(ww.eglDisplay, ww.eglSurface, rect.data(), 1);
+		return;
+	}
+#	endif
 	eglSwapBuffers(ww.eglDisplay, ww.eglSurface);
 #else
 #	error "Unknown graphics API"
 #endif
 }
+
+unsigned application::get_buffer_age(){
+	auto& ww = getImpl(this->window_pimpl);
+
+	if(!ww.buffer_age_supported){
+		return 0;
+	}
+
+#ifdef MORDAVOKNE_RENDER_OPENGL
+#	ifdef GLX_EXT_buffer_age
+	unsigned age = 0;
+	glXQueryDrawable(ww.display.display, ww.window, GLX_BACK_BUFFER_AGE_EXT, &age);
+	return age;
+#	endif
+#elif defined(MORDAVOKNE_RENDER_OPENGLES)
+#	ifdef EGL_EXT_buffer_age
+	EGLint age = 0;
+	if(eglQuerySurface(ww.eglDisplay, ww.eglSurface, EGL_BUFFER_AGE_EXT, &age) == EGL_FALSE){
+		return 0;
+	}
+	return unsigned(age);
+#	endif
+#else
+#	error "Unknown graphics API"
+#endif
+	return 0;
+}
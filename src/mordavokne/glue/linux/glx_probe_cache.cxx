@@ -0,0 +1,157 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <sstream>
+
+#include <utki/string.hpp>
+#include <papki/fs_file.hpp>
+
+namespace{
+// GLX extensions the glue is interested in. Only these are stored in the probe cache.
+const std::array<const char*, 5> known_glx_extensions = {{
+	"GLX_ARB_create_context",
+	"GLX_EXT_swap_control",
+	"GLX_EXT_swap_control_tear",
+	"GLX_MESA_swap_control",
+	"GLX_EXT_buffer_age"
+}};
+
+// Results of GLX probing, persisted in the application's storage directory.
+// On subsequent startups the cached FBConfig is looked up directly by its ID instead of
+// enumerating all the FBConfigs, and the extensions string is not queried and parsed.
+// The cache is keyed by the display, GLX client and server vendors and versions, and the
+// requested window parameters. Additionally, the GL renderer and version are checked after
+// the context is created, and the cache is rewritten if those have changed.
+struct glx_probe_cache{
+	static constexpr const char* file_name = "glx_probe_cache.txt";
+	static const unsigned format_version = 1;
+
+	std::string key;
+	int fb_config_id = 0;
+	std::vector<std::string> glx_extensions;
+	std::string gl_renderer;
+	std::string gl_version;
+
+	static std::string make_key(Display* display, int screen, const mordavokne::window_params& wp){
+		auto str = [](const char* s){
+			return s ? s : "";
+		};
+
+		std::stringstream ss;
+		ss << str(DisplayString(display)) << ";" << screen
+				<< ";" << str(glXGetClientString(display, GLX_VENDOR))
+				<< ";" << str(glXGetClientString(display, GLX_VERSION))
+				<< ";" << str(glXQueryServerString(display, screen, GLX_VENDOR))
+				<< ";" << str(glXQueryServerString(display, screen, GLX_VERSION))
+				<< ";" << wp.buffers.get(mordavokne::window_params::buffer_type::depth)
+				<< wp.buffers.get(mordavokne::window_params::buffer_type::stencil)
+				<< ";" << unsigned(wp.graphics_api_request);
+
+		auto ret = ss.str();
+
+		// the cache file is line based
+		std::replace(ret.begin(), ret.end(), '\n', ' ');
+
+		return ret;
+	}
+
+	void set_glx_extensions(std::string_view extensions_string){
+		auto exts = utki::split(extensions_string);
+
+		this->glx_extensions.clear();
+		for(auto e : known_glx_extensions){
+			if(std::find(exts.begin(), exts.end(), e) != exts.end()){
+				this->glx_extensions.push_back(e);
+			}
+		}
+	}
+
+	bool has_glx_extension(std::string_view name)const{
+		return std::find(this->glx_extensions.begin(), this->glx_extensions.end(), name) != this->glx_extensions.end();
+	}
+
+	// reads the cache file lines, returns empty vector if there is no cache file or it could not be read
+	static std::vector<std::string> read(const std::string& path){
+		try{
+			papki::fs_file fi(path);
+			if(!fi.exists()){
+				return std::vector<std::string>();
+			}
+			auto data = fi.load();
+			return utki::split(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()), '\n');
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "GLX probe cache could not be read: " << e.what() << std::endl;})
+			return std::vector<std::string>();
+		}
+	}
+
+	// returns true if the cache lines are valid and the cache key matches the given one
+	bool load(const std::vector<std::string>& lines, const std::string& key){
+		// format version, key, FBConfig ID, extensions, renderer, version
+		if(lines.size() < 6 || lines[0] != std::to_string(format_version) || lines[1] != key){
+			return false;
+		}
+
+		this->fb_config_id = std::atoi(lines[2].c_str());
+		if(this->fb_config_id == 0){
+			return false;
+		}
+
+		this->key = lines[1];
+		this->glx_extensions = utki::split(lines[3]);
+		this->gl_renderer = lines[4];
+		this->gl_version = lines[5];
+
+		return true;
+	}
+
+	// failure to save the cache is not fatal, it will be probed again on next startup
+	void save(const std::string& path)const noexcept{
+		try{
+			std::stringstream ss;
+			ss << format_version << '\n';
+			ss << this->key << '\n';
+			ss << this->fb_config_id << '\n';
+			for(auto i = this->glx_extensions.begin(); i != this->glx_extensions.end(); ++i){
+				if(i != this->glx_extensions.begin()){
+					ss << ' ';
+				}
+				ss << *i;
+			}
+			ss << '\n';
+			ss << this->gl_renderer << '\n';
+			ss << this->gl_version << '\n';
+
+			auto str = ss.str();
+
+			papki::fs_file fi(path);
+			fi.open(papki::file::mode::create);
+			utki::scope_exit scope_exit([&fi](){
+				fi.close();
+			});
+			fi.write(utki::make_span(reinterpret_cast<const uint8_t*>(str.data()), str.size()));
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "GLX probe cache could not be written: " << e.what() << std::endl;})
+		}
+	}
+};
+}
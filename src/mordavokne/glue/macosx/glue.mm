@@ -13,8 +13,12 @@
 
 using namespace mordavokne;
 
+#include "../util.hxx"
+#include "../frame_pacer.hxx"
+
 #include "../unix_common.cxx"
 #include "../friend_accessors.cxx"
+#include "../shared_gl_context.hxx"
 
 @interface CocoaView : NSView{
 	NSTrackingArea* ta;
@@ -72,8 +76,16 @@ struct WindowWrapper : public utki::destructable{
 
 	bool mouseCursorIsCurrentlyVisible = true;
 
+	frame_pacer pacer;
+
 	WindowWrapper(const window_params& wp);
 
+	void set_present_mode(window_params::present_mode mode){
+		// adaptive vsync is not supported by NSOpenGLContext
+		GLint interval = get_swap_interval(mode, false);
+		[this->openglContextId setValues:&interval forParameter:NSOpenGLContextParameterSwapInterval];
+	}
+
 	~WindowWrapper()noexcept;
 };
 
@@ -729,9 +741,27 @@ int main(int argc, const char** argv){
 	}
 
 	do{
-		render(mordavokne::inst());
+		// if it is too early for the next frame, it will be rendered after waiting till the frame deadline
+		if(!needs_render(*app) || ww.pacer.start_frame()){
+			mark_frame_phase(*app, frame_profiler::phase::wait);
+			render(*app);
+		}
+
+		uint32_t update_millis = app->gui.update();
 
-		uint32_t millis = mordavokne::inst().gui.update();
+		mark_frame_phase(*app, frame_profiler::phase::update);
+
+		ww.pacer.set_target(*app);
+
+		uint32_t millis = update_millis;
+		if(needs_render(*app)){
+			// there is a frame to render, wake up in time for the frame deadline
+			millis = std::min(millis, ww.pacer.get_wait_timeout());
+		}
+		if(is_readback_pending(*app)){
+			// captured frames are to be delivered on the next main loop cycle, which is subject to frame pacing
+			millis = ww.pacer.is_enabled() ? std::min(millis, ww.pacer.get_wait_timeout()) : 0;
+		}
 
 		NSEvent *event = [ww.applicationObjectId
 				nextEventMatchingMask:NSEventMaskAny
@@ -740,7 +770,13 @@ int main(int argc, const char** argv){
 				dequeue:YES
 			];
 
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
 		if(!event){
+			if(millis == update_millis){
+				// waiting has timed out, it's time to update the updateables, which will change the GUI
+				app->invalidate();
+			}
 			continue;
 		}
 
@@ -750,7 +786,10 @@ int main(int argc, const char** argv){
 				case NSEventTypeApplicationDefined:
 					{
 						std::unique_ptr<std::function<void()>> m(reinterpret_cast<std::function<void()>*>([event data1]));
+						trace::scope trace_scope("ui_queue message");
+						count_ui_message(*app);
 						(*m)();
+						app->invalidate();
 					}
 					break;
 				default:
@@ -766,6 +805,9 @@ int main(int argc, const char** argv){
 					dequeue:YES
 				];
 		}while(event && !ww.quitFlag);
+
+		// UI queue messages are application defined events, so these are accounted as events
+		mark_frame_phase(*app, frame_profiler::phase::events);
 	}while(!ww.quitFlag);
 
 	return 0;
@@ -835,6 +877,9 @@ application::application(std::string&& name, const window_params& wp) :
 		storage_dir(initialize_storage_dir(this->name))
 {
 	TRACE(<< "application::application(): enter" << std::endl)
+	this->set_present_mode(wp.present_mode_request);
+	this->max_fps = wp.max_fps;
+
 	this->update_window_rect(
 			morda::rectangle(
 					0,
@@ -850,6 +895,22 @@ void application::swap_frame_buffers(){
 	[ww.openglContextId flushBuffer];
 }
 
+void application::set_present_mode(window_params::present_mode mode){
+	getImpl(this->window_pimpl).set_present_mode(mode);
+	this->present_mode_v = mode;
+}
+
+unsigned application::get_buffer_age(){
+	// NSOpenGLContext does not report back buffer age
+	return 0;
+}
+
+std::unique_ptr<shared_gl_context> application::create_shared_gl_context(){
+	// NSOpenGLContext can share objects via initWithFormat:shareContext:, but OpenGL is deprecated on macOS,
+	// so the loader context is not implemented for the NSOpenGL based glue, resources are loaded on the UI thread.
+	return nullptr;
+}
+
 void application::set_fullscreen(bool enable){
 	if(enable == this->is_fullscreen()){
 		return;
@@ -0,0 +1,91 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <utki/config.hpp>
+
+#if M_OS == M_OS_LINUX && M_OS_NAME != M_OS_NAME_ANDROID
+
+#include "message_queue.hxx"
+
+#include <cerrno>
+#include <system_error>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+using namespace mordavokne;
+
+message_queue::message_queue(size_t capacity) :
+		mask([capacity](){
+			size_t size = 2;
+			while(size < capacity){
+				size <<= 1;
+			}
+			return size - 1;
+		}()),
+		cells(new cell[this->mask + 1]),
+		event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+	if(this->event_fd < 0){
+		throw std::system_error(errno, std::generic_category(), "message_queue: eventfd() failed");
+	}
+
+	for(size_t i = 0; i != this->mask + 1; ++i){
+		this->cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+message_queue::~message_queue()noexcept{
+	close(this->event_fd);
+}
+
+void message_queue::signal(){
+	// The consumer resets the flag before taking messages, so if the flag is already set, then the consumer
+	// has not started draining yet and will see the message, no need to write eventfd again.
+	if(this->signaled.exchange(true)){
+		return;
+	}
+
+	for(;;){
+		if(eventfd_write(this->event_fd, 1) == 0){
+			return;
+		}
+		if(errno != EINTR){
+			throw std::system_error(errno, std::generic_category(), "message_queue: eventfd_write() failed");
+		}
+	}
+}
+
+void message_queue::clear_signal(){
+	// Reset the eventfd counter before resetting the flag. Producers which see the flag still set skip writing eventfd,
+	// but since their messages are posted before the flag is reset, those will be taken by the following drain.
+	// Nothing to read is not an error.
+	eventfd_t value;
+	eventfd_read(this->event_fd, &value);
+
+	// the exchange synchronizes with the producers' exchange, so that their messages are visible
+	this->signaled.exchange(false);
+
+	this->readiness_flags.clear(opros::ready::read);
+}
+
+#endif
@@ -0,0 +1,315 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#include <opros/waitable.hpp>
+
+namespace mordavokne{
+
+/**
+ * @brief Move-only callable with small buffer optimization.
+ * Callables which fit into the internal buffer and can be moved without exceptions are stored
+ * within the message object itself, i.e. no memory is allocated for them. Note, that std::function
+ * fits into the buffer, so moving a std::function into a message does not allocate either.
+ * Bigger callables are allocated on the heap.
+ */
+class message{
+public:
+	static constexpr size_t buffer_size = 48;
+
+private:
+	struct operations{
+		void (*invoke)(void* buf);
+		void (*move)(void* to, void* from)noexcept;
+		void (*destroy)(void* buf)noexcept;
+	};
+
+	template <typename callable_type> struct inplace{
+		static void invoke(void* buf){
+			(*reinterpret_cast<callable_type*>(buf))();
+		}
+		static void move(void* to, void* from)noexcept{
+			new(to) callable_type(std::move(*reinterpret_cast<callable_type*>(from)));
+			reinterpret_cast<callable_type*>(from)->~callable_type();
+		}
+		static void destroy(void* buf)noexcept{
+			reinterpret_cast<callable_type*>(buf)->~callable_type();
+		}
+		static constexpr operations ops = {&invoke, &move, &destroy};
+	};
+
+	template <typename callable_type> struct boxed{
+		static callable_type*& ptr(void* buf)noexcept{
+			return *reinterpret_cast<callable_type**>(buf);
+		}
+		static void invoke(void* buf){
+			(*ptr(buf))();
+		}
+		static void move(void* to, void* from)noexcept{
+			new(to) callable_type*(ptr(from));
+		}
+		static void destroy(void* buf)noexcept{
+			delete ptr(buf);
+		}
+		static constexpr operations ops = {&invoke, &move, &destroy};
+	};
+
+	const operations* ops = nullptr;
+
+	alignas(std::max_align_t) uint8_t buffer[buffer_size];
+
+public:
+	message()noexcept = default;
+
+	template <
+			typename function_type,
+			typename callable_type = std::decay_t<function_type>,
+			typename = std::enable_if_t<!std::is_same<callable_type, message>::value>
+		>
+	message(function_type&& f){
+		if constexpr (
+				sizeof(callable_type) <= buffer_size &&
+				alignof(callable_type) <= alignof(std::max_align_t) &&
+				std::is_nothrow_move_constructible<callable_type>::value
+			)
+		{
+			new(this->buffer) callable_type(std::forward<function_type>(f));
+			this->ops = &inplace<callable_type>::ops;
+		}else{
+			new(this->buffer) callable_type*(new callable_type(std::forward<function_type>(f)));
+			this->ops = &boxed<callable_type>::ops;
+		}
+	}
+
+	message(message&& m)noexcept :
+			ops(m.ops)
+	{
+		if(this->ops){
+			this->ops->move(this->buffer, m.buffer);
+			m.ops = nullptr;
+		}
+	}
+
+	message& operator=(message&& m)noexcept{
+		if(this != &m){
+			this->reset();
+			if(m.ops){
+				m.ops->move(this->buffer, m.buffer);
+				this->ops = m.ops;
+				m.ops = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	message(const message&) = delete;
+	message& operator=(const message&) = delete;
+
+	~message()noexcept{
+		this->reset();
+	}
+
+	void reset()noexcept{
+		if(this->ops){
+			this->ops->destroy(this->buffer);
+			this->ops = nullptr;
+		}
+	}
+
+	explicit operator bool()const noexcept{
+		return this->ops != nullptr;
+	}
+
+	void operator()(){
+		ASSERT(this->ops)
+		this->ops->invoke(this->buffer);
+	}
+};
+
+/**
+ * @brief Multi-producer single-consumer message queue.
+ * Messages are posted from any thread without locking, into a bounded ring buffer of preallocated cells.
+ * Only in case the ring buffer is full, the messages go to a mutex protected overflow queue,
+ * and keep going there until the consumer drains it, so the order of messages posted by each thread is preserved.
+ *
+ * The queue is an opros::waitable, it becomes ready to read when messages are posted. The wakeup is done via
+ * eventfd, which is only written when the consumer might be waiting, i.e. at most once per drain() call.
+ *
+ * Only the main loop thread can call drain().
+ */
+class message_queue : public opros::waitable{
+	struct cell{
+		std::atomic<size_t> sequence;
+		message msg;
+	};
+
+	const size_t mask;
+	std::unique_ptr<cell[]> cells;
+
+	alignas(64) std::atomic<size_t> enqueue_pos = {0};
+
+	// only accessed by consumer
+	alignas(64) size_t dequeue_pos = 0;
+
+	// set when eventfd has been written since the last drain() call
+	alignas(64) std::atomic<bool> signaled = {false};
+
+	std::atomic<size_t> overflow_size = {0};
+	std::mutex overflow_mutex;
+	std::deque<message> overflow;
+
+	int event_fd;
+
+	// returns false if the ring buffer is full, in that case the message is not moved from
+	bool try_push(message& m)noexcept{
+		size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+		cell* c;
+		for(;;){
+			c = &this->cells[pos & this->mask];
+			size_t seq = c->sequence.load(std::memory_order_acquire);
+			auto dif = intptr_t(seq) - intptr_t(pos);
+			if(dif == 0){
+				if(this->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+					break;
+				}
+			}else if(dif < 0){
+				return false;
+			}else{
+				pos = this->enqueue_pos.load(std::memory_order_relaxed);
+			}
+		}
+
+		c->msg = std::move(m);
+		c->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_pop(message& m)noexcept{
+		cell& c = this->cells[this->dequeue_pos & this->mask];
+		if(c.sequence.load(std::memory_order_acquire) != this->dequeue_pos + 1){
+			// empty, or the message is not completely posted yet, in which case the producer will signal when done
+			return false;
+		}
+		m = std::move(c.msg);
+		c.sequence.store(this->dequeue_pos + this->mask + 1, std::memory_order_release);
+		++this->dequeue_pos;
+		return true;
+	}
+
+	void signal();
+	void clear_signal();
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param capacity - capacity of the lock-free ring buffer, rounded up to a power of 2.
+	 */
+	message_queue(size_t capacity = 1024);
+
+	message_queue(const message_queue&) = delete;
+	message_queue& operator=(const message_queue&) = delete;
+
+	~message_queue()noexcept;
+
+	int get_handle()override{
+		return this->event_fd;
+	}
+
+	/**
+	 * @brief Post message.
+	 * Thread-safe.
+	 * @param f - callable to execute from the main loop.
+	 */
+	template <typename function_type> void push_back(function_type&& f){
+		// construct the message before taking a cell, so that the cell is never left unpublished in case of exception
+		message m(std::forward<function_type>(f));
+		if(this->overflow_size.load(std::memory_order_acquire) != 0 || !this->try_push(m)){
+			std::lock_guard<decltype(this->overflow_mutex)> lock(this->overflow_mutex);
+			this->overflow.push_back(std::move(m));
+			this->overflow_size.fetch_add(1, std::memory_order_release);
+		}
+		this->signal();
+	}
+
+	/**
+	 * @brief Execute all posted messages.
+	 * Executes the messages in the order they were posted, until the queue is empty,
+	 * including the messages posted while draining.
+	 * @param handler - function which is called for each message and is supposed to invoke the message.
+	 * @return number of executed messages.
+	 */
+	template <typename handler_type> size_t drain(handler_type&& handler){
+		this->clear_signal();
+
+		size_t num_messages = 0;
+		for(;;){
+			message m;
+			if(this->try_pop(m)){
+				handler(m);
+				++num_messages;
+				continue;
+			}
+
+			if(this->overflow_size.load(std::memory_order_acquire) == 0){
+				break;
+			}
+
+			std::deque<message> batch;
+			{
+				std::lock_guard<decltype(this->overflow_mutex)> lock(this->overflow_mutex);
+
+				// A thread's message only goes to the overflow queue after its earlier messages have taken their
+				// ring buffer cells, so the overflow queue is only taken when the ring buffer is really empty.
+				// Otherwise, some producer has taken a cell but not posted the message yet, and it will signal when done.
+				// The check is done under the lock, so that all the cells taken before the overflow messages are seen.
+				if(this->enqueue_pos.load(std::memory_order_acquire) != this->dequeue_pos){
+					break;
+				}
+				std::swap(batch, this->overflow);
+			}
+			// the messages posted after the batch was taken go to the overflow queue till this point,
+			// so the order of each thread's messages is preserved
+			this->overflow_size.fetch_sub(batch.size(), std::memory_order_release);
+
+			for(auto& bm : batch){
+				handler(bm);
+				++num_messages;
+			}
+		}
+		return num_messages;
+	}
+};
+
+}
@@ -0,0 +1,430 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+#include <utki/string.hpp>
+
+#include <papki/fs_file.hpp>
+
+#if M_OS_NAME == M_OS_NAME_IOS || M_OS_NAME == M_OS_NAME_ANDROID || defined(MORDAVOKNE_RENDER_OPENGLES)
+	// The OpenGL ES renderer calls the GL functions directly, so there is nothing to hook
+#else
+#	include <GL/glew.h>
+#	define MORDAVOKNE_PROGRAM_CACHE_ARB
+#endif
+
+#include "program_cache.hxx"
+
+using namespace mordavokne;
+
+#ifdef MORDAVOKNE_PROGRAM_CACHE_ARB
+
+// GLEW calls all the functions through its global function pointers, so, when the cache is enabled,
+// the pointers the renderer uses for creating its programs are replaced with the hooks.
+
+namespace{
+struct gl_functions{
+	PFNGLSHADERSOURCEPROC shader_source = nullptr;
+	PFNGLCREATEPROGRAMPROC create_program = nullptr;
+	PFNGLATTACHSHADERPROC attach_shader = nullptr;
+	PFNGLDETACHSHADERPROC detach_shader = nullptr;
+	PFNGLBINDATTRIBLOCATIONPROC bind_attrib_location = nullptr;
+	PFNGLLINKPROGRAMPROC link_program = nullptr;
+};
+
+// filled when the hooks are installed
+gl_functions real_functions;
+
+// 64 bit FNV-1a hash
+class hasher{
+	uint64_t hash = 0xcbf29ce484222325;
+public:
+	void add(const void* data, size_t size)noexcept{
+		auto p = static_cast<const uint8_t*>(data);
+		for(size_t i = 0; i != size; ++i){
+			this->hash ^= p[i];
+			this->hash *= 0x100000001b3;
+		}
+	}
+
+	void add(uint64_t value)noexcept{
+		this->add(&value, sizeof(value));
+	}
+
+	void add(std::string_view str)noexcept{
+		this->add(uint64_t(str.size()));
+		this->add(str.data(), str.size());
+	}
+
+	uint64_t get()const noexcept{
+		return this->hash;
+	}
+};
+
+std::string to_hex(uint64_t value){
+	std::stringstream ss;
+	ss << std::hex << std::setw(16) << std::setfill('0') << value;
+	return ss.str();
+}
+
+void write_file(const std::string& path, utki::span<const uint8_t> data){
+	papki::fs_file fi(path);
+	fi.open(papki::file::mode::create);
+	utki::scope_exit scope_exit([&fi](){
+		fi.close();
+	});
+	fi.write(data);
+}
+
+class program_cache{
+	// cache directory of the current driver, ends with '/'
+	const std::string dir;
+
+	const uint64_t driver_hash;
+
+	struct program_info{
+		std::vector<GLuint> shaders;
+		std::vector<std::pair<GLuint, std::string>> attrib_bindings;
+	};
+
+	std::mutex mutex;
+
+	// shader -> source hash
+	std::unordered_map<GLuint, uint64_t> shaders;
+	std::unordered_map<GLuint, program_info> programs;
+
+	// program key -> source hashes of its shaders, for all the programs stored in the cache
+	std::unordered_map<uint64_t, std::vector<uint64_t>> index;
+
+	const std::string index_file_name = "index.txt";
+
+	// corrupt index lines are skipped, the affected programs are then just compiled and stored again
+	void load_index(){
+		papki::fs_file fi(this->dir + this->index_file_name);
+		if(!fi.exists()){
+			return;
+		}
+		auto data = fi.load();
+		auto lines = utki::split(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()), '\n');
+		for(auto& l : lines){
+			// program key followed by its shader source hashes
+			auto words = utki::split(l);
+			if(words.empty()){
+				continue;
+			}
+			try{
+				std::vector<uint64_t> sources;
+				for(auto i = std::next(words.begin()); i != words.end(); ++i){
+					sources.push_back(std::stoull(*i, nullptr, 16));
+				}
+				this->index[std::stoull(words.front(), nullptr, 16)] = std::move(sources);
+			}catch(std::logic_error& e){
+				LOG([&](auto&o){o << "program binary cache index line skipped: " << e.what() << std::endl;})
+			}
+		}
+	}
+
+	void save_index()noexcept{
+		try{
+			std::stringstream ss;
+			for(auto& e : this->index){
+				ss << to_hex(e.first);
+				for(auto s : e.second){
+					ss << ' ' << to_hex(s);
+				}
+				ss << '\n';
+			}
+			auto str = ss.str();
+			write_file(
+					this->dir + this->index_file_name,
+					utki::make_span(reinterpret_cast<const uint8_t*>(str.data()), str.size())
+				);
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "program binary cache index could not be written: " << e.what() << std::endl;})
+		}
+	}
+
+	std::string get_binary_path(uint64_t key)const{
+		return this->dir + to_hex(key) + ".bin";
+	}
+
+	// binary file consists of the binary format, 4 bytes little-endian, followed by the program binary
+	bool load_binary(GLuint program, uint64_t key){
+		std::vector<uint8_t> data;
+		try{
+			papki::fs_file fi(this->get_binary_path(key));
+			data = fi.load();
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "program binary could not be read: " << e.what() << std::endl;})
+		}
+
+		if(data.size() > 4){
+			GLenum format = GLenum(data[0]) | (GLenum(data[1]) << 8) | (GLenum(data[2]) << 16) | (GLenum(data[3]) << 24);
+			glProgramBinary(program, format, data.data() + 4, GLsizei(data.size() - 4));
+			GLint status = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if(status == GL_TRUE){
+				return true;
+			}
+		}
+
+		// the binary is invalid, e.g. the driver was updated without changing its version string
+		LOG([](auto&o){o << "cached program binary rejected, relinking" << std::endl;})
+		this->index.erase(key);
+		this->save_index();
+		return false;
+	}
+
+	void store_binary(GLuint program, uint64_t key, std::vector<uint64_t>&& sources){
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if(length <= 0){
+			return;
+		}
+
+		std::vector<uint8_t> data(size_t(length) + 4);
+		GLenum format = 0;
+		GLsizei written = 0;
+		glGetProgramBinary(program, length, &written, &format, data.data() + 4);
+		if(written <= 0){
+			return;
+		}
+		data.resize(size_t(written) + 4);
+		for(unsigned i = 0; i != 4; ++i){
+			data[i] = uint8_t(format >> (i * 8));
+		}
+
+		try{
+			write_file(this->get_binary_path(key), utki::make_span(data));
+		}catch(std::exception& e){
+			LOG([&](auto&o){o << "program binary could not be written: " << e.what() << std::endl;})
+			return;
+		}
+
+		this->index[key] = std::move(sources);
+		this->save_index();
+	}
+
+public:
+	program_cache(std::string&& dir, uint64_t driver_hash) :
+			dir(std::move(dir)),
+			driver_hash(driver_hash)
+	{
+		this->load_index();
+	}
+
+	void shader_source(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length){
+		hasher h;
+		for(GLsizei i = 0; i != count; ++i){
+			if(length && length[i] >= 0){
+				h.add(string[i], size_t(length[i]));
+			}else{
+				h.add(string[i], strlen(string[i]));
+			}
+		}
+
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+		this->shaders[shader] = h.get();
+	}
+
+	void create_program(GLuint program){
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+		this->programs[program] = program_info();
+	}
+
+	void attach_shader(GLuint program, GLuint shader){
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+		this->programs[program].shaders.push_back(shader);
+	}
+
+	void detach_shader(GLuint program, GLuint shader){
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+		auto& s = this->programs[program].shaders;
+		s.erase(std::remove(s.begin(), s.end(), shader), s.end());
+	}
+
+	void bind_attrib_location(GLuint program, GLuint index, const GLchar* name){
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+		this->programs[program].attrib_bindings.push_back(std::make_pair(index, std::string(name)));
+	}
+
+	void link_program(GLuint program){
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+
+		auto& p = this->programs[program];
+
+		hasher h;
+		h.add(this->driver_hash);
+		std::vector<uint64_t> sources;
+		for(auto s : p.shaders){
+			auto i = this->shaders.find(s);
+			uint64_t source_hash = i == this->shaders.end() ? 0 : i->second;
+			sources.push_back(source_hash);
+			h.add(source_hash);
+		}
+		for(auto& b : p.attrib_bindings){
+			h.add(uint64_t(b.first));
+			h.add(b.second);
+		}
+		uint64_t key = h.get();
+
+		if(this->index.find(key) != this->index.end() && this->load_binary(program, key)){
+			return;
+		}
+
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		real_functions.link_program(program);
+
+		GLint status = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &status);
+		if(status == GL_TRUE){
+			this->store_binary(program, key, std::move(sources));
+		}
+	}
+};
+
+// set once, before the renderer is created
+std::unique_ptr<program_cache> cache;
+
+void GLAPIENTRY hook_shader_source(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length){
+	real_functions.shader_source(shader, count, string, length);
+	if(cache){
+		cache->shader_source(shader, count, string, length);
+	}
+}
+
+GLuint GLAPIENTRY hook_create_program(){
+	GLuint ret = real_functions.create_program();
+	if(cache && ret != 0){
+		cache->create_program(ret);
+	}
+	return ret;
+}
+
+void GLAPIENTRY hook_attach_shader(GLuint program, GLuint shader){
+	real_functions.attach_shader(program, shader);
+	if(cache){
+		cache->attach_shader(program, shader);
+	}
+}
+
+void GLAPIENTRY hook_detach_shader(GLuint program, GLuint shader){
+	real_functions.detach_shader(program, shader);
+	if(cache){
+		cache->detach_shader(program, shader);
+	}
+}
+
+void GLAPIENTRY hook_bind_attrib_location(GLuint program, GLuint index, const GLchar* name){
+	real_functions.bind_attrib_location(program, index, name);
+	if(cache){
+		cache->bind_attrib_location(program, index, name);
+	}
+}
+
+void GLAPIENTRY hook_link_program(GLuint program){
+	if(cache){
+		cache->link_program(program);
+	}else{
+		real_functions.link_program(program);
+	}
+}
+}
+
+void mordavokne::enable_program_binary_cache(const std::string& storage_dir){
+	if(cache){
+		return;
+	}
+
+	GLint num_formats = 0;
+	if(!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary){
+		LOG([](auto&o){o << "program binaries are not supported" << std::endl;})
+		return;
+	}
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+	if(num_formats <= 0){
+		LOG([](auto&o){o << "driver supports no program binary formats" << std::endl;})
+		return;
+	}
+
+	hasher driver;
+	for(auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}){
+		auto str = reinterpret_cast<const char*>(glGetString(name));
+		driver.add(std::string_view(str ? str : ""));
+	}
+
+	std::string dir = storage_dir + "program_cache/";
+
+	try{
+		papki::fs_file cache_dir(dir);
+		if(!cache_dir.exists()){
+			cache_dir.make_dir();
+		}
+
+		dir.append(to_hex(driver.get())).append(1, '/');
+
+		papki::fs_file driver_dir(dir);
+		if(!driver_dir.exists()){
+			driver_dir.make_dir();
+		}
+
+		cache = std::make_unique<program_cache>(std::move(dir), driver.get());
+	}catch(std::exception& e){
+		LOG([&](auto&o){o << "program binary cache could not be initialized: " << e.what() << std::endl;})
+		return;
+	}
+
+	auto& real = real_functions;
+
+	real.shader_source = __glewShaderSource;
+	real.create_program = __glewCreateProgram;
+	real.attach_shader = __glewAttachShader;
+	real.detach_shader = __glewDetachShader;
+	real.bind_attrib_location = __glewBindAttribLocation;
+	real.link_program = __glewLinkProgram;
+
+	__glewShaderSource = &hook_shader_source;
+	__glewCreateProgram = &hook_create_program;
+	__glewAttachShader = &hook_attach_shader;
+	__glewDetachShader = &hook_detach_shader;
+	__glewBindAttribLocation = &hook_bind_attrib_location;
+	__glewLinkProgram = &hook_link_program;
+}
+
+#else
+
+void mordavokne::enable_program_binary_cache(const std::string& storage_dir){
+	// the renderer's GL calls cannot be intercepted on this platform, see above
+}
+
+#endif
@@ -0,0 +1,46 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <string>
+
+namespace mordavokne{
+
+/**
+ * @brief Enable shader program binary cache.
+ * The renderer creates its shader programs from source, so the GLEW function pointers of the program
+ * functions it uses are replaced with hooks. On program link, the program binary is looked up in the cache,
+ * and if found, it is loaded instead of linking. Otherwise, the program is linked as usual and its binary
+ * is stored in the cache. The shaders are always compiled, so their compile status is the real one.
+ * The cache is kept separately for each GL vendor/renderer/version.
+ *
+ * Only supported with desktop OpenGL, since the OpenGL ES renderer calls the GL functions directly.
+ * Does nothing if program binaries are not supported by the driver, i.e. neither OpenGL 4.1 nor
+ * GL_ARB_get_program_binary are supported, or if the driver supports no binary formats.
+ *
+ * Must be called with the GL context current, before the renderer is created.
+ * @param storage_dir - application's storage directory, the cache is stored in its subdirectory.
+ */
+void enable_program_binary_cache(const std::string& storage_dir);
+
+}
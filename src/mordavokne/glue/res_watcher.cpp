@@ -0,0 +1,173 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "res_watcher.hxx"
+
+#include "../application.hpp"
+
+#ifdef MORDAVOKNE_RES_WATCHER
+
+#include <set>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include <utki/debug.hpp>
+
+#include <papki/fs_file.hpp>
+
+using namespace mordavokne;
+
+namespace{
+const uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR;
+}
+
+res_watcher::res_watcher() :
+		fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+{
+	if(this->fd < 0){
+		throw std::system_error(errno, std::generic_category(), "res_watcher: inotify_init1() failed");
+	}
+}
+
+res_watcher::~res_watcher()noexcept{
+	close(this->fd);
+}
+
+void res_watcher::add_watch(const std::string& dir){
+	ASSERT(!dir.empty() && dir.back() == '/')
+
+	int wd = inotify_add_watch(this->fd, dir.c_str(), watch_mask);
+	if(wd < 0){
+		throw std::system_error(errno, std::generic_category(), "res_watcher: inotify_add_watch(" + dir + ") failed");
+	}
+	this->watched_dirs[wd] = dir;
+
+	// inotify does not watch subdirectories, so watch each of them explicitly
+	for(const auto& name : papki::fs_file(dir).list_dir()){
+		if(!name.empty() && name.back() == '/'){
+			this->add_watch(dir + name);
+		}
+	}
+}
+
+void res_watcher::watch(const std::string& dir, std::function<void(const std::string&)>&& handler){
+	if(dir.empty() || dir.back() != '/'){
+		throw std::invalid_argument("res_watcher::watch(): directory path must end with '/': " + dir);
+	}
+
+	this->add_watch(dir);
+	this->roots.push_back(watch_root{dir, std::move(handler)});
+}
+
+void res_watcher::handle_changes(){
+	std::set<std::string> changed;
+
+	alignas(inotify_event) char buf[4096];
+	for(;;){
+		auto len = read(this->fd, buf, sizeof(buf));
+		if(len < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			if(errno == EAGAIN){
+				break;
+			}
+			throw std::system_error(errno, std::generic_category(), "res_watcher: read() failed");
+		}
+
+		for(char* p = buf; p < buf + len;){
+			auto e = reinterpret_cast<const inotify_event*>(p);
+			p += sizeof(inotify_event) + e->len;
+
+			auto i = this->watched_dirs.find(e->wd);
+			if(i == this->watched_dirs.end()){
+				continue;
+			}
+
+			if(e->mask & IN_IGNORED){
+				// the directory was removed
+				this->watched_dirs.erase(i);
+				continue;
+			}
+
+			if(e->len == 0){
+				continue;
+			}
+
+			std::string path = i->second + e->name;
+
+			if(e->mask & IN_ISDIR){
+				if(e->mask & (IN_CREATE | IN_MOVED_TO)){
+					try{
+						this->add_watch(path + '/');
+					}catch(std::system_error& ex){
+						// the directory may have been removed or replaced right after it was created
+						if(ex.code() != std::errc::no_such_file_or_directory && ex.code() != std::errc::not_a_directory){
+							throw;
+						}
+					}
+				}
+				continue;
+			}
+
+			// files are reported when they are completely written, or moved in, which is how
+			// many editors save files, created files are reported when closed after writing
+			if(e->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)){
+				changed.insert(std::move(path));
+			}
+		}
+	}
+
+	this->readiness_flags.clear(opros::ready::read);
+
+	for(const auto& path : changed){
+		LOG([&](auto&o){o << "res_watcher: changed " << path << std::endl;})
+		for(const auto& r : this->roots){
+			if(path.compare(0, r.dir.size(), r.dir) == 0 && r.handler){
+				r.handler(path);
+			}
+		}
+	}
+}
+
+bool application::watch_resources(const std::string& dir, std::function<void(const std::string& file_name)>&& changed){
+	if(!this->res_watcher_pimpl){
+		this->res_watcher_pimpl = std::make_unique<res_watcher>();
+	}
+	ASSERT(dynamic_cast<res_watcher*>(this->res_watcher_pimpl.get()))
+	static_cast<res_watcher&>(*this->res_watcher_pimpl).watch(dir, std::move(changed));
+	return true;
+}
+
+#else
+
+using namespace mordavokne;
+
+bool application::watch_resources(const std::string& dir, std::function<void(const std::string& file_name)>&& changed){
+	return false;
+}
+
+#endif
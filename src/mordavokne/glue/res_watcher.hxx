@@ -0,0 +1,82 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <utki/config.hpp>
+#include <utki/destructable.hpp>
+
+// the headless main loop does not wait for anything but the UI queue, so watching is not supported there
+#if M_OS == M_OS_LINUX && M_OS_NAME != M_OS_NAME_ANDROID && !defined(MORDAVOKNE_WINDOW_HEADLESS)
+#	define MORDAVOKNE_RES_WATCHER
+#endif
+
+#ifdef MORDAVOKNE_RES_WATCHER
+
+#include <opros/waitable.hpp>
+
+namespace mordavokne{
+
+// Watches resource directories, including their subdirectories, for changed files via inotify.
+// The main loop adds the watcher to its wait set and calls handle_changes() when the watcher is ready to read.
+class res_watcher : public utki::destructable, public opros::waitable{
+	int fd;
+
+	struct watch_root{
+		std::string dir;
+		std::function<void(const std::string&)> handler;
+	};
+
+	std::vector<watch_root> roots;
+
+	// watch descriptor to watched directory path
+	std::map<int, std::string> watched_dirs;
+
+	void add_watch(const std::string& dir);
+
+public:
+	res_watcher();
+
+	res_watcher(const res_watcher&) = delete;
+	res_watcher& operator=(const res_watcher&) = delete;
+
+	~res_watcher()noexcept;
+
+	int get_handle()override{
+		return this->fd;
+	}
+
+	void watch(const std::string& dir, std::function<void(const std::string&)>&& handler);
+
+	// Reads all the pending events and calls the handlers for the changed files.
+	// Editors often write a file in several steps, so each file is reported once per call.
+	void handle_changes();
+};
+
+}
+
+#endif
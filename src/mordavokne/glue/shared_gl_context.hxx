@@ -0,0 +1,53 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+namespace mordavokne{
+
+/**
+ * @brief Graphics context which shares objects with the main one.
+ * Used by the background loader thread to create textures, buffers etc.
+ * which are then used by the UI thread.
+ */
+class shared_gl_context{
+public:
+	virtual ~shared_gl_context()noexcept{}
+
+	/**
+	 * @brief Make the context current for the calling thread.
+	 */
+	virtual void make_current() = 0;
+
+	/**
+	 * @brief Release the context from the calling thread.
+	 */
+	virtual void release()noexcept = 0;
+
+	/**
+	 * @brief Wait till all GL commands issued in this context are completed.
+	 * After that, the created objects can be used from the main context.
+	 */
+	virtual void wait_for_completion() = 0;
+};
+
+}
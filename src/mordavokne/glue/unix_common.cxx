@@ -20,14 +20,39 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 /* ================ LICENSE END ================ */
 
 #include "../application.hpp"
+#include "../startup.hpp"
 
 namespace{
 
 std::unique_ptr<mordavokne::application> createAppUnix(int argc, const char** argv){
-	return mordavokne::application_factory::get_factory()(utki::make_span(argv, argc));
+	mordavokne::startup::scope startup_scope("create application");
+	auto app = mordavokne::application_factory::get_factory()(utki::make_span(argv, argc));
+	startup_scope.end();
+	if(!app){
+		return app;
+	}
+
+	if(const char* file_name = getenv("MORDAVOKNE_RECORD_INPUT")){
+		app->start_input_recording(file_name);
+	}
+
+	if(const char* file_name = getenv("MORDAVOKNE_REPLAY_INPUT")){
+		const char* speed = getenv("MORDAVOKNE_REPLAY_SPEED");
+		app->start_input_replay(
+				file_name,
+				speed && std::string(speed) == "max",
+				[](){
+					mordavokne::inst().quit();
+				}
+			);
+	}
+
+	return app;
 }
 
 std::string initialize_storage_dir(const std::string& appName){
+	mordavokne::startup::scope startup_scope("storage dir");
+
 	auto homeDir = getenv("HOME");
 	if(!homeDir){
 		throw std::runtime_error("failed to get user home directory. Is HOME environment variable set?");
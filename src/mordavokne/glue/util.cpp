@@ -62,3 +62,30 @@ version_duplet mordavokne::get_opengl_version_duplet(window_params::graphics_api
 
     throw std::logic_error(ss.str());
 }
+
+int mordavokne::get_swap_interval(window_params::present_mode mode, bool adaptive_supported){
+    using pm = window_params::present_mode;
+    switch(mode){
+        case pm::vsync:
+            return 1;
+        case pm::adaptive:
+            return adaptive_supported ? -1 : 1;
+        default:
+        case pm::immediate:
+        case pm::capped:
+            return 0;
+    }
+}
+
+std::chrono::steady_clock::time_point mordavokne::monotonic_ms_to_time_point(uint32_t ms)noexcept{
+	auto now = std::chrono::steady_clock::now();
+	auto now_ms = uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count());
+
+	// unsigned arithmetic handles the timestamp wrap around
+	uint32_t age = now_ms - ms;
+	if(age > 10000){
+		return now;
+	}
+
+	return now - std::chrono::milliseconds(age);
+}
@@ -21,6 +21,8 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <chrono>
+
 #include "../application.hpp"
 
 namespace mordavokne{
@@ -32,4 +34,22 @@ struct version_duplet{
 
 version_duplet get_opengl_version_duplet(window_params::graphics_api api);
 
+/**
+ * @brief Get swap interval for presentation mode.
+ * @param mode - presentation mode.
+ * @param adaptive_supported - whether negative swap intervals (adaptive vsync) are supported by the platform.
+ * @return swap interval value as used by glXSwapIntervalEXT(), eglSwapInterval() and similar functions.
+ */
+int get_swap_interval(window_params::present_mode mode, bool adaptive_supported);
+
+/**
+ * @brief Convert input event timestamp to steady clock time point.
+ * X server, Wayland compositors and Android stamp input events with CLOCK_MONOTONIC time,
+ * which is what std::chrono::steady_clock uses on Linux.
+ * @param ms - event timestamp in milliseconds, truncated to 32 bits, as in X and Wayland events.
+ * @return Time point of the event. If the timestamp is not from the past few seconds, then
+ *         it is considered to be from some other clock and current time is returned.
+ */
+std::chrono::steady_clock::time_point monotonic_ms_to_time_point(uint32_t ms)noexcept;
+
 }
@@ -0,0 +1,1220 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#include <vector>
+#include <array>
+#include <map>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/input-event-codes.h>
+
+#include <opros/wait_set.hpp>
+#include <papki/fs_file.hpp>
+
+#include <utki/string.hpp>
+
+#include <wayland-client.h>
+#include <wayland-egl.h>
+#include <wayland-cursor.h>
+#include <xkbcommon/xkbcommon.h>
+
+// the xdg-shell protocol header and marshalling code are generated by wayland-scanner, see src/makefile
+#include "xdg-shell-client-protocol.h"
+extern "C"{
+#include "xdg-shell-protocol.c"
+}
+
+#ifdef MORDAVOKNE_RENDER_OPENGLES
+#	include <EGL/egl.h>
+#	include <EGL/eglext.h>
+#	include <GLES2/gl2.h>
+
+#	include <morda/render/opengles/renderer.hpp>
+#else
+#	error "Wayland backend only supports OpenGL ES"
+#endif
+
+#include "../../application.hpp"
+
+#include "../util.hxx"
+#include "../frame_pacer.hxx"
+#include "../message_queue.hxx"
+#include "../program_cache.hxx"
+#include "../egl_shared_context.cxx"
+
+#include "../friend_accessors.cxx"
+#include "../unix_common.cxx"
+#include "../linux/key_code_map.cxx"
+
+using namespace mordavokne;
+
+namespace{
+// input events carry timestamps in milliseconds, compositors use CLOCK_MONOTONIC for those
+void note_event_time(uint32_t time){
+	auto& app = application::inst();
+	if(app.is_input_latency_measurement()){
+		note_input_time(app, monotonic_ms_to_time_point(time));
+	}
+}
+
+// cursor names from the standard X cursor font, all cursor themes provide those
+const std::map<morda::mouse_cursor, const char*> wayland_cursor_map = {
+	{morda::mouse_cursor::arrow, "left_ptr"},
+	{morda::mouse_cursor::left_right_arrow, "sb_h_double_arrow"},
+	{morda::mouse_cursor::up_down_arrow, "sb_v_double_arrow"},
+	{morda::mouse_cursor::all_directions_arrow, "fleur"},
+	{morda::mouse_cursor::left_side, "left_side"},
+	{morda::mouse_cursor::right_side, "right_side"},
+	{morda::mouse_cursor::top_side, "top_side"},
+	{morda::mouse_cursor::bottom_side, "bottom_side"},
+	{morda::mouse_cursor::top_left_corner, "top_left_corner"},
+	{morda::mouse_cursor::top_right_corner, "top_right_corner"},
+	{morda::mouse_cursor::bottom_left_corner, "bottom_left_corner"},
+	{morda::mouse_cursor::bottom_right_corner, "bottom_right_corner"},
+	{morda::mouse_cursor::index_finger, "hand2"},
+	{morda::mouse_cursor::grab, "hand1"},
+	{morda::mouse_cursor::caret, "xterm"}
+};
+
+morda::mouse_button button_code_to_enum(uint32_t button){
+	switch(button){
+		case BTN_LEFT:
+			return morda::mouse_button::left;
+		default:
+		case BTN_MIDDLE:
+			return morda::mouse_button::middle;
+		case BTN_RIGHT:
+			return morda::mouse_button::right;
+	}
+}
+
+morda::key key_code_to_enum(uint32_t key){
+	// Wayland key codes are Linux evdev key codes which are X key codes minus 8
+	key += 8;
+	if(key >= keyCodeMap.size()){
+		return morda::key::unknown;
+	}
+	return keyCodeMap[key];
+}
+
+class key_event_unicode_provider : public morda::gui::input_string_provider{
+	xkb_state* state;
+	xkb_keycode_t keycode;
+public:
+	key_event_unicode_provider(xkb_state* state, xkb_keycode_t keycode) :
+			state(state),
+			keycode(keycode)
+	{}
+
+	std::u32string get()const override{
+		if(!this->state){
+			return std::u32string();
+		}
+
+		char32_t c = xkb_state_key_get_utf32(this->state, this->keycode);
+		if(c == 0){
+			return std::u32string();
+		}
+		return std::u32string(1, c);
+	}
+};
+}
+
+namespace{
+struct window_wrapper : public utki::destructable{
+	// the storage directory is needed by the program binary cache before the application's member is initialized
+	const std::string storage_dir;
+
+	struct display_wrapper{
+		wl_display* display;
+
+		display_wrapper(){
+			this->display = wl_display_connect(nullptr);
+			if(!this->display){
+				throw std::runtime_error("wl_display_connect() failed");
+			}
+		}
+
+		~display_wrapper(){
+			wl_display_disconnect(this->display);
+		}
+	} display;
+
+	wl_registry* registry = nullptr;
+
+	// globals
+	wl_compositor* compositor = nullptr;
+	xdg_wm_base* wm_base = nullptr;
+	wl_seat* seat = nullptr;
+	wl_shm* shm = nullptr;
+	wl_output* output = nullptr;
+
+	// output parameters, used to calculate dots per inch
+	r4::vector2<unsigned> output_resolution{0, 0};
+	r4::vector2<unsigned> output_size_mm{0, 0};
+
+	wl_surface* surface = nullptr;
+	xdg_surface* shell_surface = nullptr;
+	xdg_toplevel* toplevel = nullptr;
+
+	bool configured = false;
+
+	// new window dimensions requested by the compositor, negative if there is no pending resize
+	r4::vector2<int> new_win_dims{-1, -1};
+	r4::vector2<int> win_dims;
+
+	wl_egl_window* egl_window;
+
+	EGLDisplay eglDisplay;
+	EGLSurface eglSurface;
+	EGLContext eglContext;
+	EGLConfig eglConfig;
+
+	// whether EGL_EXT_buffer_age extension is supported
+	bool buffer_age_supported = false;
+
+#ifdef EGL_KHR_swap_buffers_with_damage
+	// nullptr if neither EGL_KHR_swap_buffers_with_damage nor EGL_EXT_swap_buffers_with_damage is supported
+	PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC eglSwapBuffersWithDamage = nullptr;
+#endif
+
+	// Pending wl_surface.frame callback. While it is not null the compositor is not ready
+	// to present a new frame, so rendering is postponed until the callback is done.
+	wl_callback* frame_callback = nullptr;
+
+	// In vsync and adaptive presentation modes the rendering is driven by the frame callbacks,
+	// in other modes the frames are presented as soon as they are rendered.
+	bool throttle_by_frame_callbacks = true;
+
+	void set_present_mode(window_params::present_mode mode){
+		switch(mode){
+			case window_params::present_mode::vsync:
+			case window_params::present_mode::adaptive:
+				this->throttle_by_frame_callbacks = true;
+				break;
+			default:
+				this->throttle_by_frame_callbacks = false;
+				break;
+		}
+	}
+
+	void request_frame_callback(){
+		if(!this->throttle_by_frame_callbacks || this->frame_callback){
+			return;
+		}
+
+		static const wl_callback_listener listener = {
+			[](void* data, wl_callback* callback, uint32_t time){
+				auto& ww = *static_cast<window_wrapper*>(data);
+				ASSERT(ww.frame_callback == callback)
+				wl_callback_destroy(callback);
+				ww.frame_callback = nullptr;
+			}
+		};
+
+		// the callback is requested before the buffer swap, so that it is committed along with the new buffer
+		this->frame_callback = wl_surface_frame(this->surface);
+		wl_callback_add_listener(this->frame_callback, &listener, this);
+	}
+
+	//===================
+	// input
+
+	wl_pointer* pointer = nullptr;
+	wl_keyboard* keyboard = nullptr;
+
+	morda::vector2 pointer_pos{0, 0};
+
+	// serial of the last pointer enter event, needed to set the cursor
+	uint32_t pointer_enter_serial = 0;
+	bool pointer_inside = false;
+
+	xkb_context* xkbContext;
+	xkb_keymap* xkbKeymap = nullptr;
+	xkb_state* xkbState = nullptr;
+
+	// key repeat is done by the client in Wayland
+	int32_t repeat_rate = 25; // characters per second
+	int32_t repeat_delay = 400; // milliseconds
+	uint32_t repeat_key = 0;
+	bool repeat_active = false;
+	std::chrono::steady_clock::time_point repeat_deadline;
+
+	uint32_t get_key_repeat_timeout()const{
+		if(!this->repeat_active){
+			return std::numeric_limits<uint32_t>::max();
+		}
+		auto now = std::chrono::steady_clock::now();
+		if(this->repeat_deadline <= now){
+			return 0;
+		}
+		return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(this->repeat_deadline - now).count());
+	}
+
+	void handle_key_repeat(application& app){
+		if(!this->repeat_active || this->repeat_rate <= 0){
+			return;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if(this->repeat_deadline > now){
+			return;
+		}
+
+		// compositor can report more than 1000 repeats per second
+		auto period = std::chrono::milliseconds(std::max(1000 / this->repeat_rate, int32_t(1)));
+
+		// auto-repeated key generates character input only, same as on other platforms
+		handle_character_input(
+				app,
+				key_event_unicode_provider(this->xkbState, this->repeat_key + 8),
+				key_code_to_enum(this->repeat_key)
+			);
+
+		this->repeat_deadline += period;
+		if(this->repeat_deadline <= now){
+			// the main loop has stalled for more than one period, do not generate a burst of repeats to catch up
+			this->repeat_deadline = now + period;
+		}
+	}
+
+	void destroy_keymap(){
+		if(this->xkbState){
+			xkb_state_unref(this->xkbState);
+			this->xkbState = nullptr;
+		}
+		if(this->xkbKeymap){
+			xkb_keymap_unref(this->xkbKeymap);
+			this->xkbKeymap = nullptr;
+		}
+	}
+
+	void set_seat_capabilities(uint32_t caps){
+		bool has_pointer = (caps & WL_SEAT_CAPABILITY_POINTER) != 0;
+		if(has_pointer && !this->pointer){
+			static const wl_pointer_listener listener = {
+				[](void* data, wl_pointer* pointer, uint32_t serial, wl_surface* surface, wl_fixed_t x, wl_fixed_t y){ // enter
+					auto& ww = *static_cast<window_wrapper*>(data);
+					ww.pointer_enter_serial = serial;
+					ww.pointer_inside = true;
+					ww.pointer_pos = morda::vector2(morda::real(wl_fixed_to_double(x)), morda::real(wl_fixed_to_double(y)));
+					ww.apply_cursor();
+					if(!application::is_created()){
+						return;
+					}
+					handleMouseHover(application::inst(), true, 0);
+					handle_mouse_move(application::inst(), ww.pointer_pos, 0);
+				},
+				[](void* data, wl_pointer* pointer, uint32_t serial, wl_surface* surface){ // leave
+					auto& ww = *static_cast<window_wrapper*>(data);
+					ww.pointer_inside = false;
+					if(!application::is_created()){
+						return;
+					}
+					handleMouseHover(application::inst(), false, 0);
+				},
+				[](void* data, wl_pointer* pointer, uint32_t time, wl_fixed_t x, wl_fixed_t y){ // motion
+					auto& ww = *static_cast<window_wrapper*>(data);
+					ww.pointer_pos = morda::vector2(morda::real(wl_fixed_to_double(x)), morda::real(wl_fixed_to_double(y)));
+					if(!application::is_created()){
+						return;
+					}
+					note_event_time(time);
+					handle_mouse_move(application::inst(), ww.pointer_pos, 0);
+				},
+				[](void* data, wl_pointer* pointer, uint32_t serial, uint32_t time, uint32_t button, uint32_t state){ // button
+					auto& ww = *static_cast<window_wrapper*>(data);
+					if(!application::is_created()){
+						return;
+					}
+					note_event_time(time);
+					handle_mouse_button(
+							application::inst(),
+							state == WL_POINTER_BUTTON_STATE_PRESSED,
+							ww.pointer_pos,
+							button_code_to_enum(button),
+							0
+						);
+				},
+				[](void* data, wl_pointer* pointer, uint32_t time, uint32_t axis, wl_fixed_t value){ // axis
+					auto& ww = *static_cast<window_wrapper*>(data);
+					if(!application::is_created() || value == 0){
+						return;
+					}
+
+					morda::mouse_button button;
+					if(axis == WL_POINTER_AXIS_VERTICAL_SCROLL){
+						button = value < 0 ? morda::mouse_button::wheel_up : morda::mouse_button::wheel_down;
+					}else{
+						button = value < 0 ? morda::mouse_button::wheel_left : morda::mouse_button::wheel_right;
+					}
+
+					note_event_time(time);
+
+					// wheel is reported as button press and release, same as in X
+					handle_mouse_button(application::inst(), true, ww.pointer_pos, button, 0);
+					handle_mouse_button(application::inst(), false, ww.pointer_pos, button, 0);
+				}
+				// the rest of the events are not sent for the seat version we bind
+			};
+
+			this->pointer = wl_seat_get_pointer(this->seat);
+			wl_pointer_add_listener(this->pointer, &listener, this);
+		}else if(!has_pointer && this->pointer){
+			wl_pointer_destroy(this->pointer);
+			this->pointer = nullptr;
+		}
+
+		bool has_keyboard = (caps & WL_SEAT_CAPABILITY_KEYBOARD) != 0;
+		if(has_keyboard && !this->keyboard){
+			static const wl_keyboard_listener listener = {
+				[](void* data, wl_keyboard* keyboard, uint32_t format, int32_t fd, uint32_t size){ // keymap
+					auto& ww = *static_cast<window_wrapper*>(data);
+					utki::scope_exit scope_exit_fd([fd](){
+						close(fd);
+					});
+
+					if(format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1){
+						return;
+					}
+
+					void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if(map == MAP_FAILED){
+						return;
+					}
+					utki::scope_exit scope_exit_map([map, size](){
+						munmap(map, size);
+					});
+
+					ww.destroy_keymap();
+
+					ww.xkbKeymap = xkb_keymap_new_from_string(
+							ww.xkbContext,
+							static_cast<const char*>(map),
+							XKB_KEYMAP_FORMAT_TEXT_V1,
+							XKB_KEYMAP_COMPILE_NO_FLAGS
+						);
+					if(!ww.xkbKeymap){
+						return;
+					}
+					ww.xkbState = xkb_state_new(ww.xkbKeymap);
+				},
+				[](void* data, wl_keyboard* keyboard, uint32_t serial, wl_surface* surface, wl_array* keys){ // enter
+				},
+				[](void* data, wl_keyboard* keyboard, uint32_t serial, wl_surface* surface){ // leave
+					auto& ww = *static_cast<window_wrapper*>(data);
+					ww.repeat_active = false;
+				},
+				[](void* data, wl_keyboard* keyboard, uint32_t serial, uint32_t time, uint32_t key, uint32_t state){ // key
+					auto& ww = *static_cast<window_wrapper*>(data);
+					if(!application::is_created()){
+						return;
+					}
+					auto& app = application::inst();
+
+					note_event_time(time);
+
+					morda::key k = key_code_to_enum(key);
+
+					if(state == WL_KEYBOARD_KEY_STATE_PRESSED){
+						handle_key_event(app, true, k);
+						handle_character_input(app, key_event_unicode_provider(ww.xkbState, key + 8), k);
+
+						if(ww.xkbKeymap && xkb_keymap_key_repeats(ww.xkbKeymap, key + 8) && ww.repeat_rate > 0){
+							ww.repeat_active = true;
+							ww.repeat_key = key;
+							ww.repeat_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ww.repeat_delay);
+						}
+					}else{
+						if(ww.repeat_active && ww.repeat_key == key){
+							ww.repeat_active = false;
+						}
+						handle_key_event(app, false, k);
+					}
+				},
+				[](void* data, wl_keyboard* keyboard, uint32_t serial, uint32_t depressed, uint32_t latched, uint32_t locked, uint32_t group){ // modifiers
+					auto& ww = *static_cast<window_wrapper*>(data);
+					if(!ww.xkbState){
+						return;
+					}
+					xkb_state_update_mask(ww.xkbState, depressed, latched, locked, 0, 0, group);
+				},
+				[](void* data, wl_keyboard* keyboard, int32_t rate, int32_t delay){ // repeat_info
+					auto& ww = *static_cast<window_wrapper*>(data);
+					ww.repeat_rate = rate;
+					ww.repeat_delay = delay;
+				}
+			};
+
+			this->keyboard = wl_seat_get_keyboard(this->seat);
+			wl_keyboard_add_listener(this->keyboard, &listener, this);
+		}else if(!has_keyboard && this->keyboard){
+			wl_keyboard_destroy(this->keyboard);
+			this->keyboard = nullptr;
+			this->repeat_active = false;
+		}
+	}
+
+	//===================
+	// cursor
+
+	wl_cursor_theme* cursor_theme = nullptr;
+	wl_surface* cursor_surface = nullptr;
+
+	morda::mouse_cursor cur_cursor = morda::mouse_cursor::arrow;
+	bool cursor_visible = true;
+
+	void apply_cursor(){
+		if(!this->pointer || !this->pointer_inside){
+			return;
+		}
+
+		if(!this->cursor_visible || this->cur_cursor == morda::mouse_cursor::none || !this->cursor_theme){
+			wl_pointer_set_cursor(this->pointer, this->pointer_enter_serial, nullptr, 0, 0);
+			return;
+		}
+
+		auto i = wayland_cursor_map.find(this->cur_cursor);
+		if(i == wayland_cursor_map.end()){
+			return;
+		}
+
+		wl_cursor* cursor = wl_cursor_theme_get_cursor(this->cursor_theme, i->second);
+		if(!cursor || cursor->image_count == 0){
+			return;
+		}
+
+		// animated cursors are not supported, take first image
+		wl_cursor_image* image = cursor->images[0];
+		wl_buffer* buffer = wl_cursor_image_get_buffer(image);
+		if(!buffer){
+			return;
+		}
+
+		wl_pointer_set_cursor(
+				this->pointer,
+				this->pointer_enter_serial,
+				this->cursor_surface,
+				int32_t(image->hotspot_x),
+				int32_t(image->hotspot_y)
+			);
+		wl_surface_attach(this->cursor_surface, buffer, 0, 0);
+		wl_surface_damage(this->cursor_surface, 0, 0, int32_t(image->width), int32_t(image->height));
+		wl_surface_commit(this->cursor_surface);
+	}
+
+	void set_cursor(morda::mouse_cursor c){
+		this->cur_cursor = c;
+		this->apply_cursor();
+	}
+
+	void set_cursor_visible(bool visible){
+		this->cursor_visible = visible;
+		this->apply_cursor();
+	}
+
+	message_queue ui_queue;
+
+	frame_pacer pacer;
+
+	volatile bool quitFlag = false;
+
+	// whether the background loader context is to be created
+	const bool background_loader;
+
+	window_wrapper(const window_params& wp, const std::string& app_name) :
+			storage_dir(initialize_storage_dir(app_name)),
+			win_dims(int(wp.dims.x()), int(wp.dims.y())),
+			background_loader(wp.background_loader)
+	{
+		//=====================
+		// bind to the globals
+
+		static const wl_output_listener output_listener = {
+			[](void* data, wl_output* output, int32_t x, int32_t y, int32_t physical_width, int32_t physical_height, int32_t subpixel, const char* make, const char* model, int32_t transform){ // geometry
+				auto& ww = *static_cast<window_wrapper*>(data);
+				ww.output_size_mm = r4::vector2<unsigned>(unsigned(std::max(physical_width, 0)), unsigned(std::max(physical_height, 0)));
+			},
+			[](void* data, wl_output* output, uint32_t flags, int32_t width, int32_t height, int32_t refresh){ // mode
+				auto& ww = *static_cast<window_wrapper*>(data);
+				if(flags & WL_OUTPUT_MODE_CURRENT){
+					ww.output_resolution = r4::vector2<unsigned>(unsigned(std::max(width, 0)), unsigned(std::max(height, 0)));
+				}
+			},
+			[](void* data, wl_output* output){}, // done
+			[](void* data, wl_output* output, int32_t factor){} // scale
+		};
+
+		static const wl_seat_listener seat_listener = {
+			[](void* data, wl_seat* seat, uint32_t caps){ // capabilities
+				static_cast<window_wrapper*>(data)->set_seat_capabilities(caps);
+			},
+			[](void* data, wl_seat* seat, const char* name){} // name
+		};
+
+		static const xdg_wm_base_listener wm_base_listener = {
+			[](void* data, xdg_wm_base* wm_base, uint32_t serial){ // ping
+				xdg_wm_base_pong(wm_base, serial);
+			}
+		};
+
+		static const wl_registry_listener registry_listener = {
+			[](void* data, wl_registry* registry, uint32_t name, const char* interface, uint32_t version){ // global
+				auto& ww = *static_cast<window_wrapper*>(data);
+				std::string_view iface(interface);
+
+				if(iface == wl_compositor_interface.name && !ww.compositor){
+					ww.compositor = static_cast<wl_compositor*>(
+							wl_registry_bind(registry, name, &wl_compositor_interface, std::min(version, 4u))
+						);
+				}else if(iface == xdg_wm_base_interface.name && !ww.wm_base){
+					ww.wm_base = static_cast<xdg_wm_base*>(
+							wl_registry_bind(registry, name, &xdg_wm_base_interface, 1)
+						);
+					xdg_wm_base_add_listener(ww.wm_base, &wm_base_listener, &ww);
+				}else if(iface == wl_seat_interface.name && !ww.seat){
+					// version 4 is enough for key repeat info, later versions add pointer events we don't handle
+					ww.seat = static_cast<wl_seat*>(
+							wl_registry_bind(registry, name, &wl_seat_interface, std::min(version, 4u))
+						);
+					wl_seat_add_listener(ww.seat, &seat_listener, &ww);
+				}else if(iface == wl_shm_interface.name && !ww.shm){
+					ww.shm = static_cast<wl_shm*>(
+							wl_registry_bind(registry, name, &wl_shm_interface, 1)
+						);
+				}else if(iface == wl_output_interface.name && !ww.output){
+					ww.output = static_cast<wl_output*>(
+							wl_registry_bind(registry, name, &wl_output_interface, std::min(version, 2u))
+						);
+					wl_output_add_listener(ww.output, &output_listener, &ww);
+				}
+			},
+			[](void* data, wl_registry* registry, uint32_t name){} // global_remove
+		};
+
+		this->registry = wl_display_get_registry(this->display.display);
+		if(!this->registry){
+			throw std::runtime_error("wl_display_get_registry() failed");
+		}
+		utki::scope_exit scope_exit_globals([this](){
+			this->destroy_globals();
+		});
+		wl_registry_add_listener(this->registry, &registry_listener, this);
+
+		// first round-trip gets the globals, second one gets the initial events of the bound globals (seat capabilities, output modes)
+		wl_display_roundtrip(this->display.display);
+		wl_display_roundtrip(this->display.display);
+
+		if(!this->compositor){
+			throw std::runtime_error("Wayland compositor does not provide wl_compositor");
+		}
+		if(!this->wm_base){
+			throw std::runtime_error("Wayland compositor does not provide xdg_wm_base");
+		}
+
+		//===============
+		// init keyboard
+
+		this->xkbContext = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+		if(!this->xkbContext){
+			throw std::runtime_error("xkb_context_new() failed");
+		}
+		utki::scope_exit scope_exit_xkb_context([this](){
+			this->destroy_keymap();
+			xkb_context_unref(this->xkbContext);
+		});
+
+		//===========
+		// init EGL
+
+		this->eglDisplay = eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(this->display.display));
+		if(this->eglDisplay == EGL_NO_DISPLAY){
+			throw std::runtime_error("eglGetDisplay(): failed, no matching display connection found");
+		}
+
+		utki::scope_exit scopeExitEGLDisplay([this](){
+			eglTerminate(this->eglDisplay);
+		});
+
+		if(eglInitialize(this->eglDisplay, nullptr, nullptr) == EGL_FALSE){
+			throw std::runtime_error("eglInitialize() failed");
+		}
+
+		{
+			std::vector<EGLint> attribs = {
+				EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+				EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT, // we want OpenGL ES 2.0
+				EGL_BLUE_SIZE, 8,
+				EGL_GREEN_SIZE, 8,
+				EGL_RED_SIZE, 8,
+				EGL_ALPHA_SIZE, 8
+			};
+			if(wp.buffers.get(window_params::buffer_type::depth)){
+				attribs.push_back(EGL_DEPTH_SIZE);
+				attribs.push_back(16);
+			}
+			if(wp.buffers.get(window_params::buffer_type::stencil)){
+				attribs.push_back(EGL_STENCIL_SIZE);
+				attribs.push_back(8);
+			}
+			attribs.push_back(EGL_NONE);
+
+			EGLint numConfigs;
+			eglChooseConfig(this->eglDisplay, attribs.data(), &eglConfig, 1, &numConfigs);
+			if(numConfigs <= 0){
+				throw std::runtime_error("eglChooseConfig() failed, no matching config found");
+			}
+		}
+
+		if(eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE){
+			throw std::runtime_error("eglBindApi() failed");
+		}
+
+		//================
+		// create window
+
+		static const xdg_surface_listener shell_surface_listener = {
+			[](void* data, xdg_surface* shell_surface, uint32_t serial){ // configure
+				auto& ww = *static_cast<window_wrapper*>(data);
+				xdg_surface_ack_configure(shell_surface, serial);
+				ww.configured = true;
+			}
+		};
+
+		static const xdg_toplevel_listener toplevel_listener = {
+			[](void* data, xdg_toplevel* toplevel, int32_t width, int32_t height, wl_array* states){ // configure
+				auto& ww = *static_cast<window_wrapper*>(data);
+				// zero dimensions mean that the compositor leaves it up to the client to decide the size
+				if(width <= 0 || height <= 0){
+					return;
+				}
+				if(width == ww.win_dims.x() && height == ww.win_dims.y()){
+					return;
+				}
+				// squash all the resizes into one, the window will be resized on next main loop cycle
+				ww.new_win_dims = r4::vector2<int>(width, height);
+			},
+			[](void* data, xdg_toplevel* toplevel){ // close
+				static_cast<window_wrapper*>(data)->quitFlag = true;
+			}
+		};
+
+		this->surface = wl_compositor_create_surface(this->compositor);
+		if(!this->surface){
+			throw std::runtime_error("wl_compositor_create_surface() failed");
+		}
+		utki::scope_exit scope_exit_surface([this](){
+			wl_surface_destroy(this->surface);
+		});
+
+		this->shell_surface = xdg_wm_base_get_xdg_surface(this->wm_base, this->surface);
+		if(!this->shell_surface){
+			throw std::runtime_error("xdg_wm_base_get_xdg_surface() failed");
+		}
+		utki::scope_exit scope_exit_shell_surface([this](){
+			xdg_surface_destroy(this->shell_surface);
+		});
+		xdg_surface_add_listener(this->shell_surface, &shell_surface_listener, this);
+
+		this->toplevel = xdg_surface_get_toplevel(this->shell_surface);
+		if(!this->toplevel){
+			throw std::runtime_error("xdg_surface_get_toplevel() failed");
+		}
+		utki::scope_exit scope_exit_toplevel([this](){
+			xdg_toplevel_destroy(this->toplevel);
+		});
+		xdg_toplevel_add_listener(this->toplevel, &toplevel_listener, this);
+
+		// the surface must be configured before attaching any buffers to it
+		wl_surface_commit(this->surface);
+		while(!this->configured){
+			if(wl_display_dispatch(this->display.display) < 0){
+				throw std::runtime_error("wl_display_dispatch() failed");
+			}
+		}
+		if(this->new_win_dims.x() > 0){
+			this->win_dims = this->new_win_dims;
+			this->new_win_dims = r4::vector2<int>(-1, -1);
+		}
+
+		this->egl_window = wl_egl_window_create(this->surface, this->win_dims.x(), this->win_dims.y());
+		if(!this->egl_window){
+			throw std::runtime_error("wl_egl_window_create() failed");
+		}
+		utki::scope_exit scope_exit_egl_window([this](){
+			wl_egl_window_destroy(this->egl_window);
+		});
+
+		this->eglSurface = eglCreateWindowSurface(
+				this->eglDisplay,
+				eglConfig,
+				reinterpret_cast<EGLNativeWindowType>(this->egl_window),
+				nullptr
+			);
+		if(this->eglSurface == EGL_NO_SURFACE){
+			throw std::runtime_error("eglCreateWindowSurface() failed");
+		}
+		utki::scope_exit scopeExitEGLSurface([this](){
+			eglDestroySurface(this->eglDisplay, this->eglSurface);
+		});
+
+		{
+			EGLint contextAttrs[] = {
+				EGL_CONTEXT_CLIENT_VERSION, 2, // we want OpenGL ES 2.0
+				EGL_NONE
+			};
+
+			this->eglContext = eglCreateContext(this->eglDisplay, eglConfig, EGL_NO_CONTEXT, contextAttrs);
+			if(this->eglContext == EGL_NO_CONTEXT){
+				throw std::runtime_error("eglCreateContext() failed");
+			}
+		}
+
+		if(eglMakeCurrent(this->eglDisplay, this->eglSurface, this->eglSurface, this->eglContext) == EGL_FALSE){
+			eglDestroyContext(this->eglDisplay, this->eglContext);
+			throw std::runtime_error("eglMakeCurrent() failed");
+		}
+		utki::scope_exit scopeExitEGLContext([this](){
+			eglMakeCurrent(this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			eglDestroyContext(this->eglDisplay, this->eglContext);
+		});
+
+		// Do not let eglSwapBuffers() block waiting for the compositor, the main loop waits for
+		// the frame callbacks itself while still handling the input events.
+		eglSwapInterval(this->eglDisplay, 0);
+
+		this->set_present_mode(wp.present_mode_request);
+
+		{
+			auto egl_extensions = utki::split(std::string_view(eglQueryString(this->eglDisplay, EGL_EXTENSIONS)));
+			auto has_extension = [&egl_extensions](std::string_view name){
+				return std::find(egl_extensions.begin(), egl_extensions.end(), name) != egl_extensions.end();
+			};
+
+#ifdef EGL_EXT_buffer_age
+			if(has_extension("EGL_EXT_buffer_age")){
+				LOG([](auto&o){o << "EGL_EXT_buffer_age is supported\n";})
+				this->buffer_age_supported = true;
+			}
+#endif
+
+#ifdef EGL_KHR_swap_buffers_with_damage
+			if(has_extension("EGL_KHR_swap_buffers_with_damage")){
+				LOG([](auto&o){o << "EGL_KHR_swap_buffers_with_damage is supported\n";})
+				this->eglSwapBuffersWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+						eglGetProcAddress("eglSwapBuffersWithDamageKHR")
+					);
+			}else if(has_extension("EGL_EXT_swap_buffers_with_damage")){
+				LOG([](auto&o){o << "EGL_EXT_swap_buffers_with_damage is supported\n";})
+				this->eglSwapBuffersWithDamage = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+						eglGetProcAddress("eglSwapBuffersWithDamageEXT")
+					);
+			}
+#endif
+		}
+
+		//=============
+		// init cursor
+
+		if(this->shm){
+			const char* theme = getenv("XCURSOR_THEME");
+			int size = 24;
+			if(const char* s = getenv("XCURSOR_SIZE")){
+				size = std::max(atoi(s), 1);
+			}
+			this->cursor_theme = wl_cursor_theme_load(theme, size, this->shm);
+			if(this->cursor_theme){
+				this->cursor_surface = wl_compositor_create_surface(this->compositor);
+			}
+		}
+
+		scope_exit_globals.reset();
+		scope_exit_xkb_context.reset();
+		scopeExitEGLDisplay.reset();
+		scope_exit_surface.reset();
+		scope_exit_shell_surface.reset();
+		scope_exit_toplevel.reset();
+		scope_exit_egl_window.reset();
+		scopeExitEGLSurface.reset();
+		scopeExitEGLContext.reset();
+	}
+
+	void destroy_globals()noexcept{
+		if(this->keyboard){
+			wl_keyboard_destroy(this->keyboard);
+		}
+		if(this->pointer){
+			wl_pointer_destroy(this->pointer);
+		}
+		if(this->seat){
+			wl_seat_destroy(this->seat);
+		}
+		if(this->output){
+			wl_output_destroy(this->output);
+		}
+		if(this->shm){
+			wl_shm_destroy(this->shm);
+		}
+		if(this->wm_base){
+			xdg_wm_base_destroy(this->wm_base);
+		}
+		if(this->compositor){
+			wl_compositor_destroy(this->compositor);
+		}
+		wl_registry_destroy(this->registry);
+	}
+
+	~window_wrapper()noexcept{
+		if(this->cursor_surface){
+			wl_surface_destroy(this->cursor_surface);
+		}
+		if(this->cursor_theme){
+			wl_cursor_theme_destroy(this->cursor_theme);
+		}
+
+		if(this->frame_callback){
+			wl_callback_destroy(this->frame_callback);
+		}
+
+		eglMakeCurrent(this->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(this->eglDisplay, this->eglContext);
+		eglDestroySurface(this->eglDisplay, this->eglSurface);
+
+		wl_egl_window_destroy(this->egl_window);
+
+		xdg_toplevel_destroy(this->toplevel);
+		xdg_surface_destroy(this->shell_surface);
+		wl_surface_destroy(this->surface);
+
+		eglTerminate(this->eglDisplay);
+
+		this->destroy_keymap();
+		xkb_context_unref(this->xkbContext);
+
+		this->destroy_globals();
+	}
+
+	morda::real get_dots_per_inch()const{
+		if(this->output_size_mm.x() == 0 || this->output_size_mm.y() == 0){
+			return morda::real(96);
+		}
+		morda::real value = ((morda::real(this->output_resolution.x()) / (morda::real(this->output_size_mm.x()) / 10.0))
+				+ (morda::real(this->output_resolution.y()) / (morda::real(this->output_size_mm.y()) / 10.0))) / 2;
+		value *= 2.54f;
+		return value;
+	}
+
+	morda::real get_dots_per_pt()const{
+		if(this->output_size_mm.x() == 0 || this->output_size_mm.y() == 0){
+			return morda::real(1);
+		}
+		return application::get_pixels_per_dp(this->output_resolution, this->output_size_mm);
+	}
+};
+
+window_wrapper& get_impl(const std::unique_ptr<utki::destructable>& pimpl){
+	ASSERT(dynamic_cast<window_wrapper*>(pimpl.get()))
+	return static_cast<window_wrapper&>(*pimpl);
+}
+
+window_wrapper& get_impl(application& app){
+	return get_impl(get_window_pimpl(app));
+}
+
+}
+
+application::application(std::string&& name, const window_params& wp) :
+		name(name),
+		window_pimpl(std::make_unique<window_wrapper>(wp, this->name)),
+		gui(std::make_shared<morda::context>(
+				[this, &wp](){
+					if(wp.program_binary_cache){
+						enable_program_binary_cache(get_impl(this->window_pimpl).storage_dir);
+					}
+					return std::make_shared<morda::render_opengles::renderer>();
+				}(),
+				std::make_shared<morda::updater>(),
+				[this](std::function<void()>&& a){
+					get_impl(get_window_pimpl(*this)).ui_queue.push_back(std::move(a));
+				},
+				[this](morda::mouse_cursor c){
+					get_impl(*this).set_cursor(c);
+				},
+				get_impl(window_pimpl).get_dots_per_inch(),
+				get_impl(window_pimpl).get_dots_per_pt()
+			)),
+		storage_dir(get_impl(window_pimpl).storage_dir)
+{
+	this->present_mode_v = wp.present_mode_request;
+	this->max_fps = wp.max_fps;
+
+	auto& ww = get_impl(*this);
+
+	xdg_toplevel_set_title(ww.toplevel, this->name.c_str());
+	xdg_toplevel_set_app_id(ww.toplevel, this->name.c_str());
+
+	this->update_window_rect(
+			morda::rectangle(
+					0,
+					0,
+					morda::real(ww.win_dims.x()),
+					morda::real(ww.win_dims.y())
+				)
+		);
+}
+
+namespace{
+
+class wayland_waitable : public opros::waitable{
+public:
+	int fd;
+
+	int get_handle() override{
+		return this->fd;
+	}
+
+	wayland_waitable(wl_display* d){
+		this->fd = wl_display_get_fd(d);
+	}
+
+	void clear_read_flag(){
+		this->readiness_flags.clear(opros::ready::read);
+	}
+};
+
+}
+
+void application::quit()noexcept{
+	auto& ww = get_impl(*this);
+
+	ww.quitFlag = true;
+}
+
+int main(int argc, const char** argv){
+	std::unique_ptr<mordavokne::application> app = createAppUnix(argc, argv);
+	if(!app){
+		return 0;
+	}
+
+	ASSERT(app)
+
+	auto& ww = get_impl(*app);
+
+	wayland_waitable wlw(ww.display.display);
+
+	opros::wait_set wait_set(3);
+
+	wait_set.add(wlw, {opros::ready::read});
+	wait_set.add(ww.ui_queue, {opros::ready::read});
+
+	// resource watcher is created when the application starts watching resources for the first time, see application::watch_resources()
+	res_watcher* rw = nullptr;
+
+	while(!ww.quitFlag){
+		wlw.clear_read_flag();
+
+		if(!rw){
+			rw = get_res_watcher(*app);
+			if(rw){
+				wait_set.add(*rw, {opros::ready::read});
+			}
+		}
+
+		uint32_t update_timeout = app->gui.update();
+
+		mark_frame_phase(*app, frame_profiler::phase::update);
+
+		ww.pacer.set_target(*app);
+
+		uint32_t timeout = update_timeout;
+		if(needs_render(*app) && !ww.frame_callback){
+			// there is a frame to render, wake up in time for the frame deadline
+			timeout = std::min(timeout, ww.pacer.get_wait_timeout());
+		}
+		timeout = std::min(timeout, ww.get_key_repeat_timeout());
+		if(is_readback_pending(*app) && !ww.frame_callback){
+			// captured frames are to be delivered on the next main loop cycle, which is subject to frame pacing
+			timeout = ww.pacer.is_enabled() ? std::min(timeout, ww.pacer.get_wait_timeout()) : 0;
+		}
+
+		// Dispatch the events which are already in the queue and announce the intention to read the socket.
+		// After that, all the queued requests are sent out before waiting.
+		while(wl_display_prepare_read(ww.display.display) != 0){
+			wl_display_dispatch_pending(ww.display.display);
+		}
+		wl_display_flush(ww.display.display);
+
+		mark_frame_phase(*app, frame_profiler::phase::events);
+
+		auto num_waitables_triggered = wait_set.wait(timeout);
+
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
+		if(wlw.flags().get(opros::ready::read)){
+			wl_display_read_events(ww.display.display);
+		}else{
+			wl_display_cancel_read(ww.display.display);
+		}
+
+		// this calls the listeners of all the arrived events
+		if(wl_display_dispatch_pending(ww.display.display) < 0){
+			throw std::runtime_error("connection to Wayland compositor is broken");
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::events);
+
+		if(num_waitables_triggered == 0 && timeout == update_timeout){
+			// waiting has timed out, this means that it's time to update the updateables, which will change the GUI
+			app->invalidate();
+		}
+
+		if(ww.ui_queue.flags().get(opros::ready::read)){
+			ww.ui_queue.drain([&app](message& m){
+				trace::scope trace_scope("ui_queue message");
+				count_ui_message(*app);
+				m();
+			});
+			app->invalidate();
+		}
+
+		if(rw && rw->flags().get(opros::ready::read)){
+			rw->handle_changes();
+			app->invalidate();
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::ui_queue);
+
+		ww.handle_key_repeat(*app);
+
+		if(ww.new_win_dims.x() > 0){
+			ww.win_dims = ww.new_win_dims;
+			ww.new_win_dims = r4::vector2<int>(-1, -1);
+			wl_egl_window_resize(ww.egl_window, ww.win_dims.x(), ww.win_dims.y(), 0, 0);
+			update_window_rect(
+					*app,
+					morda::rectangle(0, morda::vector2(morda::real(ww.win_dims.x()), morda::real(ww.win_dims.y())))
+				);
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::events);
+
+		if(ww.frame_callback){
+			// the compositor is not ready to present a new frame yet
+			continue;
+		}
+
+		if(needs_render(*app) && !ww.pacer.start_frame()){
+			// it is too early for the next frame, it will be rendered after waiting till the frame deadline
+			continue;
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
+		render(*app);
+	}
+
+	if(rw){
+		wait_set.remove(*rw);
+	}
+	wait_set.remove(ww.ui_queue);
+	wait_set.remove(wlw);
+
+	return 0;
+}
+
+void application::set_fullscreen(bool enable){
+	if(enable == this->is_fullscreen()){
+		return;
+	}
+
+	auto& ww = get_impl(*this);
+
+	// the compositor will send a configure event with the new window dimensions
+	if(enable){
+		xdg_toplevel_set_fullscreen(ww.toplevel, nullptr);
+	}else{
+		xdg_toplevel_unset_fullscreen(ww.toplevel);
+	}
+
+	this->isFullscreen_v = enable;
+}
+
+void application::set_mouse_cursor_visible(bool visible){
+	get_impl(*this).set_cursor_visible(visible);
+}
+
+void application::set_present_mode(window_params::present_mode mode){
+	get_impl(*this).set_present_mode(mode);
+	this->present_mode_v = mode;
+}
+
+void application::swap_frame_buffers(){
+	auto& ww = get_impl(*this);
+
+	ww.request_frame_callback();
+
+#ifdef EGL_KHR_swap_buffers_with_damage
+	if(this->frame_is_partial && ww.eglSwapBuffersWithDamage){
+		// damage rectangle is in surface coordinates with origin at bottom left corner, same as GL viewport
+		std::array<EGLint, 4> rect = {{
+			this->frame_damage.p.x(),
+			this->frame_damage.p.y(),
+			this->frame_damage.d.x(),
+			this->frame_damage.d.y()
+		}};
+		ww.eglSwapBuffersWithDamage(ww.eglDisplay, ww.eglSurface, rect.data(), 1);
+		return;
+	}
+#endif
+	eglSwapBuffers(ww.eglDisplay, ww.eglSurface);
+}
+
+std::unique_ptr<shared_gl_context> application::create_shared_gl_context(){
+	auto& ww = get_impl(*this);
+	if(!ww.background_loader){
+		return nullptr;
+	}
+	return std::make_unique<egl_shared_context>(ww.eglDisplay, ww.eglConfig, ww.eglContext);
+}
+
+unsigned application::get_buffer_age(){
+	auto& ww = get_impl(*this);
+
+	if(!ww.buffer_age_supported){
+		return 0;
+	}
+
+#ifdef EGL_EXT_buffer_age
+	EGLint age = 0;
+	if(eglQuerySurface(ww.eglDisplay, ww.eglSurface, EGL_BUFFER_AGE_EXT, &age) == EGL_FALSE){
+		return 0;
+	}
+	return unsigned(age);
+#else
+	return 0;
+#endif
+}
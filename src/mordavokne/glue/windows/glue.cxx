@@ -27,6 +27,9 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <papki/fs_file.hpp>
 
+#include <GL/glew.h>
+#include <GL/wglew.h>
+
 #include <morda/render/opengl/renderer.hpp>
 
 #include <Shlobj.h> // needed for SHGetFolderPathA()
@@ -34,6 +37,10 @@ along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "../../application.hpp"
 
+#include "../util.hxx"
+#include "../frame_pacer.hxx"
+#include "../shared_gl_context.hxx"
+
 #include "../friend_accessors.cxx"
 
 using namespace mordavokne;
@@ -53,8 +60,17 @@ struct WindowWrapper : public utki::destructable{
 
 	bool mouseCursorIsCurrentlyVisible = true;
 
+	frame_pacer pacer;
+
 	WindowWrapper(const window_params& wp);
 
+	void set_present_mode(window_params::present_mode mode){
+		if(!WGLEW_EXT_swap_control){
+			return;
+		}
+		wglSwapIntervalEXT(get_swap_interval(mode, WGLEW_EXT_swap_control_tear));
+	}
+
 	~WindowWrapper()noexcept;
 };
 
@@ -579,8 +595,8 @@ LRESULT	CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam){
 			}
 			return 0;
 		case WM_PAINT:
-			// we will redraw anyway on every cycle
-			// app.Render();
+			// the frame will be rendered on the current main loop cycle
+			mordavokne::inst().invalidate();
 			ValidateRect(hwnd, NULL);// This is to tell Windows that we have redrawn contents and WM_PAINT should go away from message queue.
 			return 0;
 
@@ -592,7 +608,10 @@ LRESULT	CALLBACK wndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam){
 		case WM_USER:
 			{
 				std::unique_ptr<std::function<void()>> m(reinterpret_cast<std::function<void()>*>(lParam));
+				trace::scope trace_scope("ui_queue message");
+				count_ui_message(mordavokne::inst());
 				(*m)();
+				mordavokne::inst().invalidate();
 			}
 			return 0;
 
@@ -675,6 +694,9 @@ application::application(std::string&& name, const window_params& wp) :
 		storage_dir(initialize_storage_dir(this->name)),
 		curWinRect(0, 0, -1, -1)
 {
+	this->present_mode_v = wp.present_mode_request;
+	this->max_fps = wp.max_fps;
+
 	this->update_window_rect(
 			morda::rectangle(
 					0,
@@ -704,8 +726,22 @@ void winmain(int argc, const char** argv){
 	ShowWindow(ww.hwnd, SW_SHOW);
 
 	while (!ww.quitFlag){
-		uint32_t timeout = app->gui.update();
-		//		TRACE(<< "timeout = " << timeout << std::endl)
+		uint32_t update_timeout = app->gui.update();
+		//		TRACE(<< "update_timeout = " << update_timeout << std::endl)
+
+		mark_frame_phase(*app, frame_profiler::phase::update);
+
+		ww.pacer.set_target(*app);
+
+		uint32_t timeout = update_timeout;
+		if(needs_render(*app)){
+			// there is a frame to render, wake up in time for the frame deadline
+			timeout = (std::min)(timeout, ww.pacer.get_wait_timeout()); // parentheses prevent expansion of min() macro from windows.h
+		}
+		if(is_readback_pending(*app)){
+			// captured frames are to be delivered on the next main loop cycle, which is subject to frame pacing
+			timeout = ww.pacer.is_enabled() ? (std::min)(timeout, ww.pacer.get_wait_timeout()) : 0;
+		}
 
 		DWORD status = MsgWaitForMultipleObjectsEx(
 				0,
@@ -715,9 +751,16 @@ void winmain(int argc, const char** argv){
 				MWMO_INPUTAVAILABLE
 			);
 
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
 		//		TRACE(<< "msg" << std::endl)
 
-		if (status == WAIT_OBJECT_0){
+		if(status == WAIT_TIMEOUT){
+			if(timeout == update_timeout){
+				// it's time to update the updateables, which will change the GUI
+				app->invalidate();
+			}
+		}else if (status == WAIT_OBJECT_0){
 			MSG msg;
 			while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)){
 				//				TRACE(<< "msg got, msg.message = " << msg.message << std::endl)
@@ -730,6 +773,16 @@ void winmain(int argc, const char** argv){
 			}
 		}
 
+		// UI queue messages are window messages as well, so these are accounted as events
+		mark_frame_phase(*app, frame_profiler::phase::events);
+
+		if(needs_render(*app) && !ww.pacer.start_frame()){
+			// it is too early for the next frame, it will be rendered after waiting till the frame deadline
+			continue;
+		}
+
+		mark_frame_phase(*app, frame_profiler::phase::wait);
+
 		render(*app);
 		//		TRACE(<< "loop" << std::endl)
 	}
@@ -843,6 +896,23 @@ void application::swap_frame_buffers(){
 	SwapBuffers(ww.hdc);
 }
 
+void application::set_present_mode(window_params::present_mode mode){
+	getImpl(this->window_pimpl).set_present_mode(mode);
+	this->present_mode_v = mode;
+}
+
+unsigned application::get_buffer_age(){
+	// WGL has no way to query back buffer age, so the contents are treated as undefined
+	return 0;
+}
+
+std::unique_ptr<shared_gl_context> application::create_shared_gl_context(){
+	// WGL can only make a context current on a device context, so the loader thread would need a hidden window,
+	// and wglShareLists() must be called before the main context creates any objects. Not implemented,
+	// resources are loaded on the UI thread.
+	return nullptr;
+}
+
 namespace{
 WindowWrapper::WindowWrapper(const window_params& wp){
 	this->windowClassName = "MordavokneWindowClassName";
@@ -969,6 +1039,8 @@ WindowWrapper::WindowWrapper(const window_params& wp){
 		throw std::runtime_error("GLEW initialization failed");
 	}
 
+	this->set_present_mode(wp.present_mode_request);
+
 	scopeExitHrc.release();
 	scopeExitHdc.release();
 	scopeExitHwnd.release();
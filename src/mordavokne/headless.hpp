@@ -0,0 +1,89 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <string>
+
+#include "application.hpp"
+
+/**
+ * @brief Headless backend input injection.
+ * These functions are only available when linking against the headless variant
+ * of the library, i.e. mordavokne-opengles-headless.
+ *
+ * The headless backend renders into an offscreen EGL pbuffer surface, so no window system is needed.
+ * Frames are rendered as fast as possible, without any presentation throttling.
+ * If the MORDAVOKNE_HEADLESS_FRAMES environment variable is set to a positive number,
+ * then the application quits after rendering that number of frames.
+ *
+ * The injected input events are posted to the UI thread's queue, so the functions can be called from any thread.
+ */
+namespace mordavokne{
+namespace headless{
+
+/**
+ * @brief Inject mouse move event.
+ * @param pos - new pointer position in window coordinates, y axis goes down.
+ * @param pointer_id - pointer id.
+ */
+void inject_mouse_move(const r4::vector2<float>& pos, unsigned pointer_id = 0);
+
+/**
+ * @brief Inject mouse button event.
+ * @param is_down - whether the button is pressed (true) or released (false).
+ * @param pos - pointer position in window coordinates, y axis goes down.
+ * @param button - mouse button.
+ * @param pointer_id - pointer id.
+ */
+void inject_mouse_button(bool is_down, const r4::vector2<float>& pos, morda::mouse_button button, unsigned pointer_id = 0);
+
+/**
+ * @brief Inject mouse hover event.
+ * @param is_hovered - whether the pointer entered (true) or left (false) the window.
+ * @param pointer_id - pointer id.
+ */
+void inject_mouse_hover(bool is_hovered, unsigned pointer_id = 0);
+
+/**
+ * @brief Inject key event.
+ * @param is_down - whether the key is pressed (true) or released (false).
+ * @param key - key.
+ */
+void inject_key(bool is_down, morda::key key);
+
+/**
+ * @brief Inject character input.
+ * @param chars - input characters.
+ * @param key - key which produced the characters, can be morda::key::unknown.
+ */
+void inject_character_input(std::u32string chars, morda::key key = morda::key::unknown);
+
+/**
+ * @brief Inject window resize.
+ * Changes the viewport size, as if the window was resized. The offscreen surface keeps its original size,
+ * so the rendering is clipped by the original surface dimensions.
+ * @param dims - new window dimensions in pixels.
+ */
+void inject_resize(const r4::vector2<unsigned>& dims);
+
+}
+}
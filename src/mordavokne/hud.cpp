@@ -0,0 +1,289 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "application.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+using namespace mordavokne;
+
+namespace{
+const morda::vector4 background_color(0, 0, 0, 0.6f);
+const morda::vector4 fps_color(1, 1, 1, 1);
+const morda::vector4 gpu_color(0.3f, 0.9f, 1, 1);
+const morda::vector4 messages_color(1, 0.6f, 0.2f, 1);
+const morda::vector4 update_color(0.8f, 0.5f, 1, 1);
+const morda::vector4 good_frame_color(0.2f, 0.9f, 0.2f, 1);
+const morda::vector4 late_frame_color(1, 0.9f, 0.2f, 1);
+const morda::vector4 bad_frame_color(1, 0.2f, 0.2f, 1);
+const morda::vector4 grid_color(1, 1, 1, 0.3f);
+
+// 60Hz vsync interval
+const auto frame_budget = std::chrono::microseconds(16667);
+
+// frame time corresponding to full height of the graph
+const auto graph_range = std::chrono::microseconds(50000);
+
+const size_t max_graph_frames = 120;
+
+// Collects the HUD geometry, so that it can be drawn in a single draw call.
+class hud_geometry{
+public:
+	std::vector<morda::vector2> pos;
+	std::vector<morda::vector4> clr;
+	std::vector<uint16_t> indices;
+
+	void clear(){
+		this->pos.clear();
+		this->clr.clear();
+		this->indices.clear();
+	}
+
+	bool operator==(const hud_geometry& g)const{
+		return this->pos == g.pos && this->clr == g.clr && this->indices == g.indices;
+	}
+
+	void add_rect(const morda::rectangle& r, const morda::vector4& color){
+		auto i = uint16_t(this->pos.size());
+
+		this->pos.push_back(r.p);
+		this->pos.push_back(morda::vector2(r.p.x() + r.d.x(), r.p.y()));
+		this->pos.push_back(r.p + r.d);
+		this->pos.push_back(morda::vector2(r.p.x(), r.p.y() + r.d.y()));
+
+		for(unsigned k = 0; k != 4; ++k){
+			this->clr.push_back(color);
+		}
+
+		for(uint16_t k : {0, 1, 2, 0, 2, 3}){
+			this->indices.push_back(i + k);
+		}
+	}
+
+	// Draws text consisting of digits and decimal points as seven-segment display digits.
+	// Returns width of the text.
+	morda::real add_number(morda::vector2 pos, morda::real height, const std::string& text, const morda::vector4& color){
+		// segment bits: a - top, b - top right, c - bottom right, d - bottom, e - bottom left, f - top left, g - middle
+		const std::array<uint8_t, 10> digit_segments = {{0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07, 0x7f, 0x6f}};
+
+		morda::real w = std::round(height / 2);
+		morda::real t = std::max(morda::real(1), std::round(height / 8));
+		morda::real h2 = std::round(height / 2);
+		morda::real gap = t;
+
+		morda::real start = pos.x();
+
+		for(auto c : text){
+			if(c == '.'){
+				this->add_rect(morda::rectangle(pos.x(), pos.y() + height - t, t, t), color);
+				pos.x() += t + gap;
+				continue;
+			}
+
+			if(c < '0' || c > '9'){
+				pos.x() += w + gap;
+				continue;
+			}
+
+			auto segments = digit_segments[c - '0'];
+
+			const std::array<morda::rectangle, 7> segment_rects = {{
+				morda::rectangle(t, 0, w - 2 * t, t), // a
+				morda::rectangle(w - t, 0, t, h2), // b
+				morda::rectangle(w - t, h2, t, height - h2), // c
+				morda::rectangle(t, height - t, w - 2 * t, t), // d
+				morda::rectangle(0, h2, t, height - h2), // e
+				morda::rectangle(0, 0, t, h2), // f
+				morda::rectangle(t, h2 - t / 2, w - 2 * t, t) // g
+			}};
+
+			for(unsigned i = 0; i != segment_rects.size(); ++i){
+				if(segments & (1 << i)){
+					auto r = segment_rects[i];
+					r.p += pos;
+					this->add_rect(r, color);
+				}
+			}
+
+			pos.x() += w + gap;
+		}
+
+		return pos.x() - start;
+	}
+};
+
+// HUD geometry and its GPU buffers are kept between frames. Morda vertex buffers are immutable,
+// so the buffers are only re-created when the geometry differs from the one of the previous frame.
+class hud_cache : public utki::destructable{
+public:
+	hud_geometry geometry;
+	hud_geometry prev_geometry;
+
+	std::shared_ptr<morda::vertex_array> vao;
+};
+
+std::string to_string_ms(std::chrono::microseconds us){
+	char buf[16];
+	std::snprintf(buf, sizeof(buf), "%.1f", double(us.count()) / 1000);
+	return std::string(buf);
+}
+}
+
+void application::set_hud_visible(bool visible){
+	if(this->hud_visible == visible){
+		return;
+	}
+	this->hud_visible = visible;
+	if(visible){
+		this->hud_prev_prof_enabled = this->frame_prof.is_enabled();
+		this->hud_prev_gpu_timing = this->frame_prof.is_gpu_timing();
+		if(!this->hud_prev_prof_enabled){
+			this->frame_prof.set_enabled(true);
+		}
+		this->frame_prof.set_gpu_timing(true);
+	}else{
+		this->frame_prof.set_gpu_timing(this->hud_prev_gpu_timing);
+		if(!this->hud_prev_prof_enabled){
+			this->frame_prof.set_enabled(false);
+		}
+		this->hud_pimpl.reset();
+	}
+	this->invalidate();
+}
+
+void application::render_hud(){
+	auto& prof = this->frame_prof;
+
+	// scale the HUD for high resolution screens
+	morda::real scale = std::max(morda::real(1), std::round(this->curWinRect.d.y() / 720));
+
+	morda::real margin = 8 * scale;
+	morda::real digit_height = 16 * scale;
+	morda::real graph_height = 60 * scale;
+	morda::real bar_width = 2 * scale;
+	morda::real width = bar_width * max_graph_frames;
+
+	if(!this->hud_pimpl){
+		this->hud_pimpl = std::make_unique<hud_cache>();
+	}
+	auto& cache = static_cast<hud_cache&>(*this->hud_pimpl);
+
+	auto& g = cache.geometry;
+	g.clear();
+
+	g.add_rect(
+			morda::rectangle(0, 0, width + 2 * margin, digit_height * 2 + graph_height + margin * 4),
+			background_color
+		);
+
+	// number of frames presented during the last second
+	unsigned fps = 0;
+	{
+		std::chrono::microseconds time(0);
+		for(size_t i = prof.size(); i != 0 && time < std::chrono::seconds(1); --i){
+			time += prof[i - 1].total;
+			++fps;
+		}
+	}
+
+	const frame_profiler::frame_record* last_gpu = nullptr;
+	for(size_t i = prof.size(); i != 0; --i){
+		if(prof[i - 1].has_gpu_render){
+			last_gpu = &prof[i - 1];
+			break;
+		}
+	}
+
+	morda::vector2 pos(margin, margin);
+
+	pos.x() += g.add_number(pos, digit_height, std::to_string(fps), fps_color) + 3 * margin;
+
+	if(last_gpu){
+		g.add_number(pos, digit_height, to_string_ms(last_gpu->gpu_render), gpu_color);
+	}
+
+	// frame time graph, most recent frame is on the right
+	{
+		morda::real bottom = margin * 2 + digit_height + graph_height;
+		auto to_height = [graph_height](std::chrono::microseconds t){
+			return graph_height * std::min(morda::real(1), morda::real(t.count()) / morda::real(graph_range.count()));
+		};
+
+		for(unsigned k = 1; k <= 2; ++k){
+			g.add_rect(
+					morda::rectangle(margin, std::round(bottom - to_height(frame_budget * k)), width, scale),
+					grid_color
+				);
+		}
+
+		size_t num_bars = std::min(prof.size(), max_graph_frames);
+		morda::real x = margin + width - bar_width * num_bars;
+		for(size_t i = prof.size() - num_bars; i != prof.size(); ++i){
+			auto t = prof[i].total;
+
+			const morda::vector4* color = &good_frame_color;
+			if(t > frame_budget * 2){
+				color = &bad_frame_color;
+			}else if(t > frame_budget){
+				color = &late_frame_color;
+			}
+
+			morda::real h = std::max(scale, to_height(t));
+			g.add_rect(morda::rectangle(x, bottom - h, bar_width, h), *color);
+			x += bar_width;
+		}
+	}
+
+	pos = morda::vector2(margin, margin * 3 + digit_height + graph_height);
+
+	if(prof.size() != 0){
+		auto& last = prof[prof.size() - 1];
+		pos.x() += g.add_number(pos, digit_height, std::to_string(last.num_ui_messages), messages_color) + 3 * margin;
+		g.add_number(pos, digit_height, to_string_ms(last.phases[size_t(frame_profiler::phase::update)]), update_color);
+	}
+
+	auto& r = *this->gui.context->renderer;
+
+	if(!cache.vao || !(g == cache.prev_geometry)){
+		cache.vao = r.factory->create_vertex_array(
+				{
+					r.factory->create_vertex_buffer(utki::make_span(g.pos)),
+					r.factory->create_vertex_buffer(utki::make_span(g.clr))
+				},
+				r.factory->create_index_buffer(utki::make_span(g.indices)),
+				morda::vertex_array::mode::triangles
+			);
+		std::swap(cache.geometry, cache.prev_geometry);
+	}
+
+	// transform to window coordinates, y goes down
+	morda::matrix4 matrix(r.initial_matrix);
+	matrix.translate(-1, 1);
+	matrix.scale(morda::vector2(2 / this->curWinRect.d.x(), -2 / this->curWinRect.d.y()));
+
+	r.set_blend_enabled(true);
+	r.set_simple_alpha_blending();
+
+	r.shader->pos_clr->render(matrix, *cache.vao);
+}
@@ -0,0 +1,112 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "latency_histogram.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace mordavokne;
+
+constexpr std::chrono::microseconds latency_histogram::bucket_width;
+constexpr size_t latency_histogram::num_buckets;
+
+void latency_histogram::add(std::chrono::microseconds latency)noexcept{
+	if(latency < std::chrono::microseconds::zero()){
+		latency = std::chrono::microseconds::zero();
+	}
+
+	size_t index = std::min(size_t(latency / bucket_width), this->buckets_v.size() - 1);
+	++this->buckets_v[index];
+
+	++this->num_samples;
+	this->sum += latency;
+	this->max_v = std::max(this->max_v, latency);
+	this->min_v = std::min(this->min_v, latency);
+}
+
+void latency_histogram::clear()noexcept{
+	this->buckets_v.fill(0);
+	this->num_samples = 0;
+	this->sum = std::chrono::microseconds::zero();
+	this->max_v = std::chrono::microseconds::zero();
+	this->min_v = std::chrono::microseconds::max();
+}
+
+std::chrono::microseconds latency_histogram::get_percentile(float percent)const noexcept{
+	if(this->num_samples == 0){
+		return std::chrono::microseconds::zero();
+	}
+
+	// nearest rank method
+	percent = std::max(0.0f, std::min(percent, 100.0f));
+	uint64_t rank = std::max(uint64_t(1), uint64_t(std::ceil(percent / 100 * this->num_samples)));
+
+	uint64_t count = 0;
+	for(size_t i = 0; i != this->buckets_v.size() - 1; ++i){
+		count += this->buckets_v[i];
+		if(count >= rank){
+			return std::min(bucket_width * (i + 1), this->max_v);
+		}
+	}
+
+	return this->max_v;
+}
+
+std::ostream& mordavokne::operator<<(std::ostream& o, const latency_histogram& h){
+	auto to_ms = [](std::chrono::microseconds t){
+		return double(t.count()) / 1000;
+	};
+
+	o << "samples = " << h.size()
+			<< ", min = " << to_ms(h.min()) << " ms"
+			<< ", mean = " << to_ms(h.mean()) << " ms"
+			<< ", p50 = " << to_ms(h.get_percentile(50)) << " ms"
+			<< ", p95 = " << to_ms(h.get_percentile(95)) << " ms"
+			<< ", p99 = " << to_ms(h.get_percentile(99)) << " ms"
+			<< ", max = " << to_ms(h.max()) << " ms" << std::endl;
+
+	if(h.size() == 0){
+		return o;
+	}
+
+	auto max_count = *std::max_element(h.buckets().begin(), h.buckets().end());
+
+	const unsigned bar_width = 50;
+
+	for(size_t i = 0; i != h.buckets().size(); ++i){
+		auto count = h.buckets()[i];
+		if(count == 0){
+			continue;
+		}
+
+		if(i == h.buckets().size() - 1){
+			o << ">= " << i << " ms\t";
+		}else{
+			o << i << "-" << (i + 1) << " ms\t";
+		}
+
+		o << std::string(size_t(bar_width * count / max_count), '#') << " " << count << std::endl;
+	}
+
+	return o;
+}
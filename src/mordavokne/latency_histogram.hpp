@@ -0,0 +1,132 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace mordavokne{
+
+/**
+ * @brief Histogram of latencies.
+ * Latencies are counted in buckets of 1 millisecond width, latencies of 200 milliseconds
+ * and more are counted in the last overflow bucket.
+ */
+class latency_histogram{
+public:
+	/**
+	 * @brief Width of a bucket.
+	 */
+	static constexpr std::chrono::microseconds bucket_width = std::chrono::milliseconds(1);
+
+	/**
+	 * @brief Number of buckets, including the overflow bucket.
+	 */
+	static constexpr size_t num_buckets = 201;
+
+private:
+	std::array<uint64_t, num_buckets> buckets_v;
+
+	uint64_t num_samples = 0;
+
+	std::chrono::microseconds sum = std::chrono::microseconds::zero();
+	std::chrono::microseconds max_v = std::chrono::microseconds::zero();
+	std::chrono::microseconds min_v = std::chrono::microseconds::max();
+
+public:
+	latency_histogram(){
+		this->clear();
+	}
+
+	/**
+	 * @brief Add latency sample.
+	 * @param latency - latency to add.
+	 */
+	void add(std::chrono::microseconds latency)noexcept;
+
+	/**
+	 * @brief Discard all the samples.
+	 */
+	void clear()noexcept;
+
+	/**
+	 * @brief Get bucket counters.
+	 * Bucket i counts the latencies from i * bucket_width inclusive to (i + 1) * bucket_width exclusive.
+	 * The last bucket counts all the latencies which do not fit into the other buckets.
+	 * @return Bucket counters.
+	 */
+	const decltype(buckets_v)& buckets()const noexcept{
+		return this->buckets_v;
+	}
+
+	/**
+	 * @brief Get number of samples.
+	 * @return Number of samples added since the last clear.
+	 */
+	uint64_t size()const noexcept{
+		return this->num_samples;
+	}
+
+	/**
+	 * @brief Get minimal latency.
+	 * @return Minimal latency, zero if there are no samples.
+	 */
+	std::chrono::microseconds min()const noexcept{
+		return this->num_samples == 0 ? std::chrono::microseconds::zero() : this->min_v;
+	}
+
+	/**
+	 * @brief Get maximal latency.
+	 * @return Maximal latency, zero if there are no samples.
+	 */
+	std::chrono::microseconds max()const noexcept{
+		return this->max_v;
+	}
+
+	/**
+	 * @brief Get mean latency.
+	 * @return Mean latency, zero if there are no samples.
+	 */
+	std::chrono::microseconds mean()const noexcept{
+		return this->num_samples == 0 ? std::chrono::microseconds::zero() : this->sum / this->num_samples;
+	}
+
+	/**
+	 * @brief Get percentile.
+	 * The result precision is the bucket width.
+	 * @param percent - percentile to get, from 0 to 100.
+	 * @return Upper bound of the bucket which contains the percentile, zero if there are no samples.
+	 *         For the overflow bucket it is the maximal latency.
+	 */
+	std::chrono::microseconds get_percentile(float percent)const noexcept;
+};
+
+/**
+ * @brief Print histogram in human readable form.
+ * Prints latency summary followed by the non-empty buckets, one per line.
+ */
+std::ostream& operator<<(std::ostream& o, const latency_histogram& h);
+
+}
@@ -0,0 +1,757 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+
+#include "res_pack.hpp"
+
+#include <list>
+#include <array>
+#include <mutex>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#include <papki/fs_file.hpp>
+
+#if M_OS == M_OS_WINDOWS
+#	include <utki/windows.hpp>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+// LZ4 support is enabled by the build system together with linking to liblz4, it is not enabled
+// on mobile platforms, where resource packs are not used, and for MSVC builds, which have no LZ4 package
+#ifdef MORDAVOKNE_RES_PACK_LZ4
+#	include <lz4.h>
+#	include <lz4hc.h>
+#endif
+
+using namespace mordavokne;
+
+namespace{
+const std::array<uint8_t, 8> signature = {{'M', 'R', 'D', 'V', 'P', 'A', 'C', 'K'}};
+const uint32_t format_version = 2;
+
+const size_t header_size = 32;
+const size_t slot_size = 4;
+const size_t data_alignment = 16;
+
+uint32_t read_u32(const uint8_t* p)noexcept{
+	uint32_t ret = 0;
+	for(unsigned i = 0; i != 4; ++i){
+		ret |= uint32_t(p[i]) << (i * 8);
+	}
+	return ret;
+}
+
+uint64_t read_u64(const uint8_t* p)noexcept{
+	return uint64_t(read_u32(p)) | (uint64_t(read_u32(p + 4)) << 32);
+}
+
+void write_u32(std::vector<uint8_t>& buf, uint32_t v){
+	for(unsigned i = 0; i != 4; ++i){
+		buf.push_back(uint8_t(v >> (i * 8)));
+	}
+}
+
+void write_u64(std::vector<uint8_t>& buf, uint64_t v){
+	write_u32(buf, uint32_t(v));
+	write_u32(buf, uint32_t(v >> 32));
+}
+
+uint64_t hash_path(std::string_view path)noexcept{
+	// FNV-1a
+	uint64_t h = 0xcbf29ce484222325;
+	for(auto c : path){
+		h ^= uint8_t(c);
+		h *= 0x100000001b3;
+	}
+	return h;
+}
+
+size_t align(size_t offset)noexcept{
+	return (offset + data_alignment - 1) & ~(data_alignment - 1);
+}
+
+size_t entry_size(uint32_t version)noexcept{
+	// version 1 has no original size field
+	return version == 1 ? 32 : 40;
+}
+
+struct entry{
+	uint64_t hash;
+	uint64_t data_offset;
+	uint64_t data_size;
+	uint64_t original_size;
+	uint32_t path_offset;
+	uint32_t path_size;
+
+	bool is_compressed()const noexcept{
+		return this->data_size != this->original_size;
+	}
+};
+
+entry read_entry(utki::span<const uint8_t> data, uint32_t version, uint32_t index)noexcept{
+	auto p = data.data() + header_size + size_t(index) * entry_size(version);
+	if(version == 1){
+		return entry{
+			read_u64(p),
+			read_u64(p + 8),
+			read_u64(p + 16),
+			read_u64(p + 16),
+			read_u32(p + 24),
+			read_u32(p + 28)
+		};
+	}
+	return entry{
+		read_u64(p),
+		read_u64(p + 8),
+		read_u64(p + 16),
+		read_u64(p + 24),
+		read_u32(p + 32),
+		read_u32(p + 36)
+	};
+}
+}
+
+class res_pack::mapping{
+public:
+	utki::span<const uint8_t> data;
+
+	mapping(const std::string& file_name){
+#if M_OS == M_OS_WINDOWS
+		HANDLE file = CreateFileA(
+				file_name.c_str(),
+				GENERIC_READ,
+				FILE_SHARE_READ,
+				NULL,
+				OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+				NULL
+			);
+		if(file == INVALID_HANDLE_VALUE){
+			throw std::runtime_error("res_pack: could not open file: " + file_name);
+		}
+		utki::scope_exit file_scope_exit([file](){
+			CloseHandle(file);
+		});
+
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size)){
+			throw std::runtime_error("res_pack: GetFileSizeEx() failed");
+		}
+		if(size.QuadPart == 0){
+			throw std::invalid_argument("res_pack: file is empty: " + file_name);
+		}
+
+		// the view keeps the mapping object alive, so the handles can be closed right after mapping
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if(!map){
+			throw std::runtime_error("res_pack: CreateFileMapping() failed");
+		}
+		utki::scope_exit map_scope_exit([map](){
+			CloseHandle(map);
+		});
+
+		auto ptr = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+		if(!ptr){
+			throw std::runtime_error("res_pack: MapViewOfFile() failed");
+		}
+		this->data = utki::make_span(reinterpret_cast<const uint8_t*>(ptr), size_t(size.QuadPart));
+#else
+		int fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+		if(fd < 0){
+			throw std::runtime_error("res_pack: could not open file: " + file_name);
+		}
+		utki::scope_exit fd_scope_exit([fd](){
+			close(fd);
+		});
+
+		struct stat st;
+		if(fstat(fd, &st) != 0){
+			throw std::runtime_error("res_pack: fstat() failed");
+		}
+		if(st.st_size == 0){
+			throw std::invalid_argument("res_pack: file is empty: " + file_name);
+		}
+
+		// the mapping stays valid after the file descriptor is closed
+		auto ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+		if(ptr == MAP_FAILED){
+			throw std::runtime_error("res_pack: mmap() failed");
+		}
+		this->data = utki::make_span(reinterpret_cast<const uint8_t*>(ptr), size_t(st.st_size));
+#endif
+	}
+
+	mapping(const mapping&) = delete;
+	mapping& operator=(const mapping&) = delete;
+
+	~mapping()noexcept{
+#if M_OS == M_OS_WINDOWS
+		UnmapViewOfFile(this->data.data());
+#else
+		munmap(const_cast<uint8_t*>(this->data.data()), this->data.size());
+#endif
+	}
+};
+
+class res_pack::cache{
+	const size_t capacity;
+
+	std::mutex mutex;
+
+	size_t size = 0;
+
+	typedef std::list<std::pair<uint32_t, std::shared_ptr<const std::vector<uint8_t>>>> lru_list_type;
+
+	// most recently used go first
+	lru_list_type lru_list;
+
+	std::unordered_map<uint32_t, lru_list_type::iterator> index_to_lru;
+
+public:
+	cache(size_t capacity) :
+			capacity(capacity)
+	{}
+
+	std::shared_ptr<const std::vector<uint8_t>> get(uint32_t index){
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+
+		auto i = this->index_to_lru.find(index);
+		if(i == this->index_to_lru.end()){
+			return nullptr;
+		}
+
+		this->lru_list.splice(this->lru_list.begin(), this->lru_list, i->second);
+		return i->second->second;
+	}
+
+	// returns the cached data, which can be different from the given one if the same file
+	// was decompressed concurrently by another thread
+	std::shared_ptr<const std::vector<uint8_t>> put(uint32_t index, std::shared_ptr<const std::vector<uint8_t>> data){
+		ASSERT(data)
+
+		if(data->size() > this->capacity){
+			return data;
+		}
+
+		std::lock_guard<decltype(this->mutex)> lock(this->mutex);
+
+		auto i = this->index_to_lru.find(index);
+		if(i != this->index_to_lru.end()){
+			return i->second->second;
+		}
+
+		this->lru_list.emplace_front(index, data);
+		this->index_to_lru[index] = this->lru_list.begin();
+		this->size += data->size();
+
+		// evicted data stays alive as long as it is referenced by opened files
+		while(this->size > this->capacity){
+			ASSERT(!this->lru_list.empty())
+			auto& e = this->lru_list.back();
+			this->size -= e.second->size();
+			this->index_to_lru.erase(e.first);
+			this->lru_list.pop_back();
+		}
+
+		return data;
+	}
+};
+
+res_pack::res_pack(const std::string& file_name, size_t cache_capacity) :
+		map(std::make_unique<mapping>(file_name)),
+		decompressed_cache(std::make_unique<cache>(cache_capacity)),
+		data(this->map->data)
+{
+	if(this->data.size() < header_size || !std::equal(signature.begin(), signature.end(), this->data.begin())){
+		throw std::invalid_argument("res_pack: not a resource pack: " + file_name);
+	}
+
+	auto p = this->data.data() + signature.size();
+
+	this->version = read_u32(p);
+	if(this->version == 0 || this->version > format_version){
+		throw std::invalid_argument("res_pack: unsupported format version: " + file_name);
+	}
+
+	this->num_entries = read_u32(p + 4);
+	this->table_size = read_u32(p + 8);
+
+	switch(this->version == 1 ? 0 : read_u32(p + 12)){
+		case 0:
+			this->compression_method = compression::none;
+			break;
+		case 1:
+			this->compression_method = compression::lz4;
+			break;
+		default:
+			throw std::invalid_argument("res_pack: unknown compression method: " + file_name);
+	}
+
+	if(read_u64(p + 16) != this->data.size()){
+		throw std::invalid_argument("res_pack: file is truncated: " + file_name);
+	}
+
+	// the table must have at least one empty slot for the lookup to terminate
+	if(this->table_size == 0 || (this->table_size & (this->table_size - 1)) != 0 || this->table_size <= this->num_entries){
+		throw std::invalid_argument("res_pack: invalid hash table size: " + file_name);
+	}
+
+	size_t index_end = header_size + size_t(this->num_entries) * entry_size(this->version) + size_t(this->table_size) * slot_size;
+	if(index_end > this->data.size()){
+		throw std::invalid_argument("res_pack: index is out of file bounds: " + file_name);
+	}
+
+	// validate entries once, so that lookups do not need bounds checking
+	for(uint32_t i = 0; i != this->num_entries; ++i){
+		auto e = read_entry(this->data, this->version, i);
+		if(
+				e.data_offset > this->data.size() || e.data_size > this->data.size() - e.data_offset ||
+				size_t(e.path_offset) + size_t(e.path_size) > this->data.size() ||
+				(e.is_compressed() && this->compression_method == compression::none)
+			)
+		{
+			std::stringstream ss;
+			ss << "res_pack: entry " << i << " is invalid: " << file_name;
+			throw std::invalid_argument(ss.str());
+		}
+	}
+
+	LOG([&](auto&o){o << "res_pack: opened " << file_name << ", " << this->num_entries << " files" << std::endl;})
+}
+
+res_pack::~res_pack()noexcept{}
+
+std::string res_pack::entry_path(uint32_t index)const noexcept{
+	auto e = read_entry(this->data, this->version, index);
+	return std::string(reinterpret_cast<const char*>(this->data.data() + e.path_offset), e.path_size);
+}
+
+uint32_t res_pack::find(const std::string& path)const noexcept{
+	auto h = hash_path(path);
+	auto table = this->data.data() + header_size + size_t(this->num_entries) * entry_size(this->version);
+	uint32_t mask = this->table_size - 1;
+
+	// a corrupt table may have no empty slots, so do not probe more slots than there are
+	uint32_t slot = uint32_t(h) & mask;
+	for(uint32_t i = 0; i != this->table_size; ++i, slot = (slot + 1) & mask){
+		uint32_t v = read_u32(table + size_t(slot) * slot_size);
+		if(v == 0 || v > this->num_entries){
+			return this->num_entries;
+		}
+		auto e = read_entry(this->data, this->version, v - 1);
+		if(
+				e.hash == h &&
+				e.path_size == path.size() &&
+				std::memcmp(this->data.data() + e.path_offset, path.data(), path.size()) == 0
+			)
+		{
+			return v - 1;
+		}
+	}
+	return this->num_entries;
+}
+
+uint32_t res_pack::lower_bound(const std::string& path)const noexcept{
+	uint32_t first = 0;
+	uint32_t count = this->num_entries;
+	while(count != 0){
+		uint32_t step = count / 2;
+		uint32_t i = first + step;
+		auto e = read_entry(this->data, this->version, i);
+		if(path.compare(0, std::string::npos, reinterpret_cast<const char*>(this->data.data() + e.path_offset), e.path_size) > 0){
+			first = i + 1;
+			count -= step + 1;
+		}else{
+			count = step;
+		}
+	}
+	return first;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> res_pack::decompress(uint32_t index)const{
+	if(auto cached = this->decompressed_cache->get(index)){
+		return cached;
+	}
+
+	auto e = read_entry(this->data, this->version, index);
+	ASSERT(e.is_compressed())
+	ASSERT(this->compression_method == compression::lz4)
+
+#ifdef MORDAVOKNE_RES_PACK_LZ4
+	if(e.data_size > uint64_t(LZ4_MAX_INPUT_SIZE) || e.original_size > uint64_t(std::numeric_limits<int>::max())){
+		throw std::runtime_error("res_pack: compressed file is too big");
+	}
+
+	auto ret = std::make_shared<std::vector<uint8_t>>(size_t(e.original_size));
+	int size = LZ4_decompress_safe(
+			reinterpret_cast<const char*>(this->data.data() + e.data_offset),
+			reinterpret_cast<char*>(ret->data()),
+			int(e.data_size),
+			int(ret->size())
+		);
+	if(size < 0 || size_t(size) != ret->size()){
+		throw std::runtime_error("res_pack: compressed file data is corrupted: " + this->entry_path(index));
+	}
+
+	return this->decompressed_cache->put(index, std::move(ret));
+#else
+	throw std::runtime_error("res_pack: LZ4 compression is not supported on this platform");
+#endif
+}
+
+res_pack::file_data res_pack::get(const std::string& path)const{
+	auto i = this->find(path);
+	if(i == this->num_entries){
+		throw std::out_of_range("res_pack: file not found: " + path);
+	}
+
+	file_data ret;
+
+	auto e = read_entry(this->data, this->version, i);
+	if(e.is_compressed()){
+		ret.decompressed = this->decompress(i);
+		ret.bytes = utki::make_span(*ret.decompressed);
+	}else{
+		ret.bytes = utki::make_span(this->data.data() + e.data_offset, size_t(e.data_size));
+	}
+
+	return ret;
+}
+
+bool res_pack::contains_dir(const std::string& path)const noexcept{
+	auto i = this->lower_bound(path);
+	if(i == this->num_entries){
+		return false;
+	}
+	auto e = read_entry(this->data, this->version, i);
+	return e.path_size > path.size() &&
+			std::memcmp(this->data.data() + e.path_offset, path.data(), path.size()) == 0;
+}
+
+std::vector<std::string> res_pack::list_dir(const std::string& path)const{
+	std::vector<std::string> ret;
+
+	// entries are sorted by path, so all files of the directory go in a row,
+	// and all files of each subdirectory go in a row as well
+	for(auto i = this->lower_bound(path); i != this->num_entries; ++i){
+		auto p = this->entry_path(i);
+		if(p.size() <= path.size() || p.compare(0, path.size(), path) != 0){
+			break;
+		}
+
+		auto slash = p.find('/', path.size());
+		auto name = slash == std::string::npos ?
+				p.substr(path.size()) :
+				p.substr(path.size(), slash + 1 - path.size());
+
+		if(ret.empty() || ret.back() != name){
+			ret.push_back(std::move(name));
+		}
+	}
+
+	return ret;
+}
+
+namespace{
+class res_pack_file : public papki::file{
+	std::shared_ptr<const res_pack> pack;
+
+	// compressed files are decompressed on open, and the data is held till the file is closed
+	mutable res_pack::file_data data;
+
+	// files which are not in the pack, or are opened for writing, are accessed from the filesystem
+	mutable std::unique_ptr<papki::file> fallback;
+
+public:
+	res_pack_file(std::shared_ptr<const res_pack> pack, const std::string& path = std::string()) :
+			papki::file(path),
+			pack(std::move(pack))
+	{
+		ASSERT(this->pack)
+	}
+
+	void open_internal(mode mode)override{
+		if(mode == papki::file::mode::read && this->pack->contains(this->path())){
+			this->data = this->pack->get(this->path());
+			return;
+		}
+
+		this->fallback = std::make_unique<papki::fs_file>(this->path());
+		this->fallback->open(mode);
+	}
+
+	void close_internal()const noexcept override{
+		if(this->fallback){
+			this->fallback->close();
+			this->fallback.reset();
+		}
+		this->data = res_pack::file_data();
+	}
+
+	size_t read_internal(utki::span<uint8_t> buf)const override{
+		if(this->fallback){
+			return this->fallback->read(buf);
+		}
+
+		auto contents = this->data.span();
+		ASSERT(this->cur_pos() <= contents.size())
+		size_t num_bytes = std::min(buf.size(), contents.size() - this->cur_pos());
+		std::memcpy(buf.data(), contents.data() + this->cur_pos(), num_bytes);
+		return num_bytes;
+	}
+
+	size_t write_internal(utki::span<const uint8_t> buf)override{
+		if(this->fallback){
+			return this->fallback->write(buf);
+		}
+		throw std::logic_error("res_pack_file: write() is not supported by resource pack");
+	}
+
+	size_t seek_forward_internal(size_t num_bytes)const override{
+		if(this->fallback){
+			return this->fallback->seek_forward(num_bytes);
+		}
+
+		ASSERT(this->cur_pos() <= this->data.span().size())
+		return std::min(num_bytes, this->data.span().size() - this->cur_pos());
+	}
+
+	size_t seek_backward_internal(size_t num_bytes)const override{
+		if(this->fallback){
+			return this->fallback->seek_backward(num_bytes);
+		}
+		return std::min(num_bytes, this->cur_pos());
+	}
+
+	void rewind_internal()const override{
+		if(this->fallback){
+			this->fallback->rewind();
+		}
+	}
+
+	bool exists()const override{
+		if(this->is_open()){
+			return true;
+		}
+
+		if(this->is_dir()){
+			if(this->pack->contains_dir(this->path())){
+				return true;
+			}
+		}else if(this->pack->contains(this->path())){
+			return true;
+		}
+
+		return papki::fs_file(this->path()).exists();
+	}
+
+	std::vector<std::string> list_dir(size_t max_entries = 0)const override{
+		if(!this->is_dir()){
+			throw std::logic_error("res_pack_file::list_dir(): this is not a directory");
+		}
+
+		if(!this->pack->contains_dir(this->path())){
+			return papki::fs_file(this->path()).list_dir(max_entries);
+		}
+
+		auto ret = this->pack->list_dir(this->path());
+		if(max_entries != 0 && ret.size() > max_entries){
+			ret.resize(max_entries);
+		}
+		return ret;
+	}
+
+	std::unique_ptr<papki::file> spawn()override{
+		return std::make_unique<res_pack_file>(this->pack);
+	}
+};
+}
+
+std::unique_ptr<papki::file> res_pack::make_file(std::shared_ptr<const res_pack> pack, const std::string& path){
+	return std::make_unique<res_pack_file>(std::move(pack), path);
+}
+
+namespace{
+void collect_files(const std::string& dir, std::vector<std::string>& out){
+	for(const auto& name : papki::fs_file(dir).list_dir()){
+		if(!name.empty() && name.back() == '/'){
+			collect_files(dir + name, out);
+		}else{
+			out.push_back(dir + name);
+		}
+	}
+}
+}
+
+size_t res_pack::write(const std::string& file_name, const std::vector<std::string>& dirs, compression method){
+#ifndef MORDAVOKNE_RES_PACK_LZ4
+	if(method == compression::lz4){
+		throw std::invalid_argument("res_pack::write(): LZ4 compression is not supported on this platform");
+	}
+#endif
+
+	std::vector<std::string> paths;
+	for(const auto& d : dirs){
+		if(d.empty() || d.back() != '/'){
+			throw std::invalid_argument("res_pack::write(): directory path must end with '/': " + d);
+		}
+		collect_files(d, paths);
+	}
+
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	if(paths.size() >= size_t(std::numeric_limits<uint32_t>::max()) / 2){
+		throw std::invalid_argument("res_pack::write(): too many files");
+	}
+
+	auto num_entries = uint32_t(paths.size());
+
+	// keep the table at most half full, so that probe sequences stay short
+	uint32_t table_size = 1;
+	while(table_size < num_entries * 2 + 1){
+		table_size <<= 1;
+	}
+
+	// stored data and original size of each file
+	std::vector<std::pair<std::vector<uint8_t>, size_t>> contents;
+	contents.reserve(paths.size());
+	for(const auto& p : paths){
+		auto c = papki::fs_file(p).load();
+		auto original_size = c.size();
+
+#ifdef MORDAVOKNE_RES_PACK_LZ4
+		if(method == compression::lz4 && c.size() != 0 && c.size() <= size_t(LZ4_MAX_INPUT_SIZE)){
+			std::vector<uint8_t> compressed(size_t(LZ4_compressBound(int(c.size()))));
+			int size = LZ4_compress_HC(
+					reinterpret_cast<const char*>(c.data()),
+					reinterpret_cast<char*>(compressed.data()),
+					int(c.size()),
+					int(compressed.size()),
+					LZ4HC_CLEVEL_DEFAULT
+				);
+
+			// store compressed only if it saves at least 1/16 of the size, otherwise decompression is not worth it
+			if(size > 0 && size_t(size) < c.size() - c.size() / 16){
+				compressed.resize(size_t(size));
+				c = std::move(compressed);
+			}
+		}
+#endif
+
+		contents.emplace_back(std::move(c), original_size);
+	}
+
+	// layout
+	size_t strings_offset = header_size + size_t(num_entries) * entry_size(format_version) + size_t(table_size) * slot_size;
+	size_t strings_size = 0;
+	for(const auto& p : paths){
+		strings_size += p.size();
+	}
+	if(strings_offset + strings_size > size_t(std::numeric_limits<uint32_t>::max())){
+		throw std::invalid_argument("res_pack::write(): paths are too long");
+	}
+
+	std::vector<uint64_t> data_offsets;
+	data_offsets.reserve(paths.size());
+	size_t pack_size = align(strings_offset + strings_size);
+	for(const auto& c : contents){
+		data_offsets.push_back(pack_size);
+		pack_size = align(pack_size + c.first.size());
+	}
+
+	// index
+	std::vector<uint8_t> index;
+	index.reserve(align(strings_offset + strings_size));
+
+	index.insert(index.end(), signature.begin(), signature.end());
+	write_u32(index, format_version);
+	write_u32(index, num_entries);
+	write_u32(index, table_size);
+	write_u32(index, method == compression::lz4 ? 1 : 0);
+	write_u64(index, pack_size);
+	ASSERT(index.size() == header_size)
+
+	std::vector<uint32_t> table(table_size, 0);
+
+	size_t path_offset = strings_offset;
+	for(uint32_t i = 0; i != num_entries; ++i){
+		auto h = hash_path(paths[i]);
+
+		write_u64(index, h);
+		write_u64(index, data_offsets[i]);
+		write_u64(index, contents[i].first.size());
+		write_u64(index, contents[i].second);
+		write_u32(index, uint32_t(path_offset));
+		write_u32(index, uint32_t(paths[i].size()));
+		path_offset += paths[i].size();
+
+		uint32_t mask = table_size - 1;
+		uint32_t slot = uint32_t(h) & mask;
+		while(table[slot] != 0){
+			slot = (slot + 1) & mask;
+		}
+		table[slot] = i + 1;
+	}
+
+	for(auto v : table){
+		write_u32(index, v);
+	}
+	ASSERT(index.size() == strings_offset)
+
+	for(const auto& p : paths){
+		index.insert(index.end(), p.begin(), p.end());
+	}
+	index.resize(align(index.size()), 0);
+
+	papki::fs_file fi(file_name);
+	fi.open(papki::file::mode::create);
+	utki::scope_exit scope_exit([&fi](){
+		fi.close();
+	});
+
+	fi.write(utki::make_span(index));
+
+	const std::array<uint8_t, data_alignment> padding = {{0}};
+	for(const auto& c : contents){
+		fi.write(utki::make_span(c.first));
+		if(auto rem = c.first.size() % data_alignment){
+			fi.write(utki::make_span(padding.data(), data_alignment - rem));
+		}
+	}
+
+	return paths.size();
+}
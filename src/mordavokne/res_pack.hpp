@@ -0,0 +1,223 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <utki/span.hpp>
+
+#include <papki/file.hpp>
+
+namespace mordavokne{
+
+/**
+ * @brief Read-only resource pack.
+ * Resource pack is a single file containing many resource files, together with a hash-indexed directory of them.
+ * The pack file is memory-mapped, so opening the pack is a single open() system call, the file contents are
+ * read directly from the mapping and the pages are shared via the page cache between all processes which
+ * use the same pack.
+ *
+ * File paths are stored in the pack exactly as they are passed to application::get_res_file(), e.g.
+ * "res/main.res" or "../../res/morda_res/main.res". Directories are not stored, the directory path is a prefix
+ * of its files' paths and it is always ended with '/'.
+ *
+ * Each file can be independently compressed with LZ4. Compressed files are decompressed on first open and kept
+ * in a bounded-size cache of decompressed files, the least recently used files are evicted from the cache when it
+ * exceeds its capacity. Note, that the LZ4 support is only built by the makefile based builds, i.e. not on
+ * Android, iOS and with MSVC, opening a compressed file throws an exception there.
+ *
+ * Resource packs are built with the mordavokne-res-pack tool, see also res_pack::write().
+ *
+ * The pack format, all numbers are little-endian:
+ * - header: 8 bytes signature "MRDVPACK", uint32 format version, uint32 number of entries,
+ *   uint32 hash table size (a power of 2), uint32 compression method (0 - none, 1 - LZ4), uint64 pack file size;
+ * - entries, sorted by path: uint64 FNV-1a hash of the path, uint64 data offset, uint64 data size,
+ *   uint64 original size, uint32 path offset, uint32 path size; the file data is compressed with the
+ *   pack's compression method if the data size differs from the original size, otherwise it is stored as is;
+ *   the format version 1 has no original size field, all the files are stored as is;
+ * - hash table: uint32 slots, each slot holds entry index plus one, or 0 if the slot is empty,
+ *   collisions are resolved by linear probing;
+ * - path strings, not null-terminated;
+ * - file data, each file's data is aligned to 16 bytes.
+ */
+class res_pack{
+public:
+	/**
+	 * @brief File compression method.
+	 */
+	enum class compression{
+		none,
+		lz4
+	};
+
+	/**
+	 * @brief Default capacity of the decompressed files cache in bytes.
+	 */
+	static constexpr size_t default_cache_capacity = 16 * 1024 * 1024;
+
+private:
+	class mapping;
+	std::unique_ptr<mapping> map;
+
+	class cache;
+	std::unique_ptr<cache> decompressed_cache;
+
+	utki::span<const uint8_t> data;
+
+	uint32_t version;
+	uint32_t num_entries;
+	uint32_t table_size;
+	compression compression_method;
+
+	std::shared_ptr<const std::vector<uint8_t>> decompress(uint32_t index)const;
+
+	// returns entry index or num_entries if not found
+	uint32_t find(const std::string& path)const noexcept;
+
+	std::string entry_path(uint32_t index)const noexcept;
+
+	// returns index of the first entry with the path not less than the given one
+	uint32_t lower_bound(const std::string& path)const noexcept;
+
+public:
+	/**
+	 * @brief Open resource pack.
+	 * Memory-maps the pack file and validates its header.
+	 * @param file_name - resource pack file name.
+	 * @param cache_capacity - capacity of the decompressed files cache in bytes.
+	 * @throw std::runtime_error - in case the file could not be opened or mapped.
+	 * @throw std::invalid_argument - in case the file is not a valid resource pack.
+	 */
+	res_pack(const std::string& file_name, size_t cache_capacity = default_cache_capacity);
+
+	res_pack(const res_pack&) = delete;
+	res_pack& operator=(const res_pack&) = delete;
+
+	~res_pack()noexcept;
+
+	/**
+	 * @brief File contents.
+	 * For files stored as is, the contents is the memory-mapped pack file itself, no copying is done.
+	 * For compressed files, the contents is the decompressed data, which is kept alive by this object
+	 * even if it is evicted from the cache.
+	 * In any case, the contents is valid as long as both this object and the res_pack object exist.
+	 */
+	class file_data{
+		friend class res_pack;
+
+		std::shared_ptr<const std::vector<uint8_t>> decompressed;
+		utki::span<const uint8_t> bytes;
+
+	public:
+		/**
+		 * @brief Get file contents.
+		 * @return span of the file contents.
+		 */
+		utki::span<const uint8_t> span()const noexcept{
+			return this->bytes;
+		}
+
+		/**
+		 * @brief Check if the contents is read directly from the memory-mapped pack file.
+		 * @return true if the file is stored uncompressed.
+		 * @return false if the file was decompressed.
+		 */
+		bool is_mapped()const noexcept{
+			return !this->decompressed;
+		}
+	};
+
+	/**
+	 * @brief Get file contents.
+	 * Compressed files are decompressed, or taken from the decompressed files cache.
+	 * @param path - path of the file within the pack.
+	 * @return file contents.
+	 * @throw std::out_of_range - in case there is no such file in the pack.
+	 * @throw std::runtime_error - in case the file data is corrupted or LZ4 is not supported.
+	 */
+	file_data get(const std::string& path)const;
+
+	/**
+	 * @brief Check if the pack has the file.
+	 * @param path - path of the file within the pack.
+	 * @return true if the pack has the file.
+	 * @return false otherwise.
+	 */
+	bool contains(const std::string& path)const noexcept{
+		return this->find(path) != this->num_entries;
+	}
+
+	/**
+	 * @brief Check if the pack has the directory.
+	 * The directory is considered to exist if the pack has at least one file within it.
+	 * @param path - path of the directory, must end with '/'.
+	 * @return true if the pack has files within the directory.
+	 * @return false otherwise.
+	 */
+	bool contains_dir(const std::string& path)const noexcept;
+
+	/**
+	 * @brief List directory contents.
+	 * @param path - path of the directory, must end with '/'.
+	 * @return list of files and subdirectories of the directory, subdirectory names end with '/'.
+	 */
+	std::vector<std::string> list_dir(const std::string& path)const;
+
+	/**
+	 * @brief Get number of files in the pack.
+	 * @return number of files.
+	 */
+	size_t size()const noexcept{
+		return this->num_entries;
+	}
+
+	/**
+	 * @brief Create file interface into the resource pack.
+	 * Files which are not found in the pack are accessed from the filesystem, the same way as
+	 * papki::fs_file does. Files opened for writing are always accessed from the filesystem.
+	 * @param pack - resource pack.
+	 * @param path - file path to initialize the file interface with.
+	 * @return file interface.
+	 */
+	static std::unique_ptr<papki::file> make_file(std::shared_ptr<const res_pack> pack, const std::string& path = std::string());
+
+	/**
+	 * @brief Write resource pack.
+	 * All files of the given directories, including subdirectories, are stored to the pack.
+	 * The file paths are stored as directory path plus the path within the directory, so the directory paths
+	 * should be given the same way as the application passes them to application::get_res_file().
+	 * When compression is requested, each file is compressed separately and is stored compressed only if
+	 * that saves at least 1/16 of its size, so already compressed files, like PNG or JPEG images, are stored as is.
+	 * @param file_name - output resource pack file name.
+	 * @param dirs - directories to store into the pack, each must end with '/'.
+	 * @param method - compression method.
+	 * @return number of files stored to the pack.
+	 */
+	static size_t write(const std::string& file_name, const std::vector<std::string>& dirs, compression method = compression::none);
+};
+
+}
@@ -0,0 +1,117 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "startup.hpp"
+#include "trace.hpp"
+
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+
+using namespace mordavokne;
+
+namespace{
+// static initialization is done by the main thread when the library is loaded
+const auto program_start = std::chrono::steady_clock::now();
+const auto main_thread_id = std::this_thread::get_id();
+
+std::mutex mutex;
+std::vector<startup::phase> phases;
+std::chrono::microseconds first_frame(0);
+
+std::chrono::microseconds since_start(std::chrono::steady_clock::time_point t){
+	return std::chrono::duration_cast<std::chrono::microseconds>(t - program_start);
+}
+}
+
+void startup::record(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end){
+	if(trace::is_enabled()){
+		trace::record(name, trace::get_timestamp_ns(begin), trace::get_timestamp_ns(end));
+	}
+
+	std::lock_guard<decltype(mutex)> lock(mutex);
+	phases.push_back(phase{
+		name,
+		since_start(begin),
+		std::chrono::duration_cast<std::chrono::microseconds>(end - begin),
+		std::this_thread::get_id() != main_thread_id
+	});
+}
+
+void startup::mark_first_frame(){
+	{
+		std::lock_guard<decltype(mutex)> lock(mutex);
+		if(first_frame.count() != 0){
+			return;
+		}
+		first_frame = since_start(std::chrono::steady_clock::now());
+	}
+
+	const char* report = getenv("MORDAVOKNE_STARTUP_REPORT");
+	if(report && *report != '\0'){
+		write_report(std::cerr);
+	}
+}
+
+std::chrono::microseconds startup::get_time_to_first_frame()noexcept{
+	std::lock_guard<decltype(mutex)> lock(mutex);
+	return first_frame;
+}
+
+std::vector<startup::phase> startup::get_phases(){
+	std::vector<phase> ret;
+	{
+		std::lock_guard<decltype(mutex)> lock(mutex);
+		ret = phases;
+	}
+	std::stable_sort(ret.begin(), ret.end(), [](const phase& a, const phase& b){
+		return a.begin < b.begin;
+	});
+	return ret;
+}
+
+void startup::write_report(std::ostream& o){
+	auto to_ms = [](std::chrono::microseconds us){
+		return double(us.count()) / 1000;
+	};
+
+	auto flags = o.flags();
+	auto precision = o.precision();
+
+	o << std::fixed << std::setprecision(3);
+	o << "startup phases (start ms, duration ms):" << std::endl;
+	for(auto& p : get_phases()){
+		o << "  " << std::setw(10) << to_ms(p.begin) << " " << std::setw(10) << to_ms(p.duration) << "  "
+				<< p.name << (p.on_helper_thread ? " [helper thread]" : "") << std::endl;
+	}
+
+	auto ttff = get_time_to_first_frame();
+	if(ttff.count() != 0){
+		o << "time to first frame: " << to_ms(ttff) << " ms" << std::endl;
+	}
+
+	o.flags(flags);
+	o.precision(precision);
+}
@@ -0,0 +1,140 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Startup time instrumentation.
+ * Durations of the startup phases, like display connection, GL context creation, input method setup,
+ * renderer and storage directory initialization, are recorded from the program start till the first frame
+ * is rendered. The times are counted from the moment the library is loaded, which is practically the
+ * process start.
+ *
+ * Phases are also recorded as trace events, see trace.hpp.
+ *
+ * If the MORDAVOKNE_STARTUP_REPORT environment variable is set to a non-empty value, then the startup
+ * report is printed to stderr right after the first frame is rendered.
+ */
+namespace mordavokne{
+namespace startup{
+
+/**
+ * @brief Startup phase record.
+ */
+struct phase{
+	/**
+	 * @brief Phase name.
+	 */
+	std::string name;
+
+	/**
+	 * @brief Phase start time.
+	 * Counted from the program start.
+	 */
+	std::chrono::microseconds begin;
+
+	/**
+	 * @brief Phase duration.
+	 */
+	std::chrono::microseconds duration;
+
+	/**
+	 * @brief Whether the phase was executed on a helper thread.
+	 * Phases on the helper thread overlap with the ones executed on the main thread.
+	 */
+	bool on_helper_thread;
+};
+
+/**
+ * @brief Get recorded startup phases.
+ * The phases are sorted by start time.
+ * @return Startup phases.
+ */
+std::vector<phase> get_phases();
+
+/**
+ * @brief Get time to first frame.
+ * @return Time from program start till the first frame was presented.
+ * @return Zero if no frames were rendered yet.
+ */
+std::chrono::microseconds get_time_to_first_frame()noexcept;
+
+/**
+ * @brief Print startup report.
+ * Prints the startup phases and the time to first frame in human readable form.
+ * @param o - stream to print the report to.
+ */
+void write_report(std::ostream& o);
+
+// called by the application when the first frame is presented, not supposed to be used directly
+void mark_first_frame();
+
+// record phase, called by scope, not supposed to be used directly
+void record(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+/**
+ * @brief Scoped startup phase.
+ * Records a phase which spans the lifetime of the scope object.
+ * Can be used from any thread.
+ */
+class scope{
+	const char* name;
+	std::chrono::steady_clock::time_point begin;
+public:
+	/**
+	 * @brief Begin phase.
+	 * @param name - phase name. Must be a string literal or otherwise be alive till the program exit,
+	 *               since the name is also recorded as trace event.
+	 */
+	scope(const char* name) :
+			name(name),
+			begin(std::chrono::steady_clock::now())
+	{}
+
+	scope(const scope&) = delete;
+	scope& operator=(const scope&) = delete;
+
+	/**
+	 * @brief End phase before the scope object is destroyed.
+	 */
+	void end(){
+		if(!this->name){
+			return;
+		}
+		record(this->name, this->begin, std::chrono::steady_clock::now());
+		this->name = nullptr;
+	}
+
+	~scope()noexcept{
+		try{
+			this->end();
+		}catch(...){}
+	}
+};
+
+}
+}
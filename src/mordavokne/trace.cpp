@@ -0,0 +1,401 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "trace.hpp"
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#include <papki/fs_file.hpp>
+
+using namespace mordavokne;
+
+std::atomic<bool> trace::enabled_flag(false);
+
+namespace{
+const size_t max_events_per_thread = 1 << 16;
+
+const auto epoch = std::chrono::steady_clock::now();
+
+struct event{
+	const char* name;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+struct thread_buffer{
+	const unsigned tid;
+
+	// only accessed under registry mutex
+	std::string name;
+
+	// Only the owner thread writes the events, it publishes each new event by incrementing the size.
+	std::vector<event> events;
+	std::atomic<size_t> size;
+
+	thread_buffer(unsigned tid) :
+			tid(tid),
+			events(max_events_per_thread),
+			size(0)
+	{}
+};
+
+struct registry{
+	std::mutex mutex;
+
+	// buffers are never freed, so that the events of exited threads are kept
+	std::vector<std::unique_ptr<thread_buffer>> buffers;
+};
+
+registry& get_registry(){
+	static registry r;
+	return r;
+}
+
+thread_buffer& get_thread_buffer(){
+	thread_local thread_buffer* buffer = [](){
+		auto& r = get_registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.buffers.push_back(std::make_unique<thread_buffer>(unsigned(r.buffers.size() + 1)));
+		return r.buffers.back().get();
+	}();
+	return *buffer;
+}
+
+struct thread_events{
+	unsigned tid;
+	std::string name;
+	std::vector<event> events;
+};
+
+// take snapshot of events recorded by all threads
+std::vector<thread_events> get_events(){
+	std::vector<thread_events> ret;
+
+	auto& r = get_registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+
+	for(auto& b : r.buffers){
+		thread_events te;
+		te.tid = b->tid;
+		te.name = b->name.empty() ? std::string("thread ") + std::to_string(b->tid) : b->name;
+
+		size_t size = b->size.load(std::memory_order_acquire);
+		te.events.assign(b->events.begin(), std::next(b->events.begin(), size));
+
+		// events are recorded when scope ends, so inner events go before outer ones, sort by begin time
+		std::stable_sort(
+				te.events.begin(),
+				te.events.end(),
+				[](const event& a, const event& b){
+					if(a.begin_ns == b.begin_ns){
+						return a.end_ns > b.end_ns;
+					}
+					return a.begin_ns < b.begin_ns;
+				}
+			);
+
+		ret.push_back(std::move(te));
+	}
+
+	return ret;
+}
+
+void write(papki::file& fi, const std::string& data){
+	fi.open(papki::file::mode::create);
+	utki::scope_exit file_scope_exit([&fi](){
+		fi.close();
+	});
+	fi.write(utki::span<const uint8_t>(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+}
+}
+
+void trace::set_enabled(bool enable)noexcept{
+	enabled_flag.store(enable, std::memory_order_relaxed);
+}
+
+void trace::set_thread_name(const std::string& name){
+	auto& b = get_thread_buffer();
+
+	auto& r = get_registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	b.name = name;
+}
+
+void trace::clear()noexcept{
+	auto& r = get_registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for(auto& b : r.buffers){
+		b->size.store(0, std::memory_order_release);
+	}
+}
+
+uint64_t trace::get_timestamp_ns(std::chrono::steady_clock::time_point time)noexcept{
+	if(time < epoch){
+		return 0;
+	}
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(time - epoch).count());
+}
+
+void trace::record(const char* name, uint64_t begin_ns, uint64_t end_ns)noexcept{
+	auto& b = get_thread_buffer();
+
+	size_t size = b.size.load(std::memory_order_relaxed);
+	if(size == b.events.size()){
+		// buffer is full
+		return;
+	}
+
+	b.events[size] = event{name, begin_ns, end_ns};
+	b.size.store(size + 1, std::memory_order_release);
+}
+
+namespace{
+void write_json_string(std::ostream& o, const std::string& str){
+	o << '"';
+	for(auto c : str){
+		switch(c){
+			case '"':
+				o << "\\\"";
+				break;
+			case '\\':
+				o << "\\\\";
+				break;
+			default:
+				if(uint8_t(c) < 0x20){
+					o << ' ';
+				}else{
+					o << c;
+				}
+				break;
+		}
+	}
+	o << '"';
+}
+}
+
+void trace::write_chrome_json(papki::file& fi){
+	auto threads = get_events();
+
+	std::stringstream ss;
+	ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	auto separator = [&first, &ss](){
+		if(first){
+			first = false;
+		}else{
+			ss << ',';
+		}
+		ss << '\n';
+	};
+
+	for(auto& t : threads){
+		separator();
+		ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t.tid << ",\"args\":{\"name\":";
+		write_json_string(ss, t.name);
+		ss << "}}";
+
+		for(auto& e : t.events){
+			separator();
+			ss << "{\"name\":";
+			write_json_string(ss, e.name);
+			// timestamps are in microseconds
+			ss << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << t.tid
+					<< ",\"ts\":" << (e.begin_ns / 1000) << '.' << (e.begin_ns / 100 % 10)
+					<< ",\"dur\":" << ((e.end_ns - e.begin_ns) / 1000) << '.' << ((e.end_ns - e.begin_ns) / 100 % 10)
+					<< '}';
+		}
+	}
+
+	ss << "\n]}\n";
+
+	write(fi, ss.str());
+}
+
+namespace{
+// minimal protobuf encoder
+class proto_writer{
+public:
+	std::string buf;
+
+	void write_varint(uint64_t v){
+		while(v >= 0x80){
+			this->buf.push_back(char(uint8_t(v) | 0x80));
+			v >>= 7;
+		}
+		this->buf.push_back(char(uint8_t(v)));
+	}
+
+	void write_uint(unsigned field, uint64_t v){
+		this->write_varint(uint64_t(field) << 3); // wire type 0: varint
+		this->write_varint(v);
+	}
+
+	void write_bytes(unsigned field, const std::string& data){
+		this->write_varint((uint64_t(field) << 3) | 2); // wire type 2: length delimited
+		this->write_varint(data.size());
+		this->buf.append(data);
+	}
+};
+
+// Perfetto trace proto field numbers, see perfetto/protos/perfetto/trace/
+const unsigned trace_packet = 1;
+
+const unsigned trace_packet_timestamp = 8;
+const unsigned trace_packet_trusted_packet_sequence_id = 10;
+const unsigned trace_packet_track_event = 11;
+const unsigned trace_packet_sequence_flags = 13;
+const unsigned trace_packet_track_descriptor = 60;
+
+const unsigned track_descriptor_uuid = 1;
+const unsigned track_descriptor_thread = 4;
+
+const unsigned thread_descriptor_pid = 1;
+const unsigned thread_descriptor_tid = 2;
+const unsigned thread_descriptor_thread_name = 5;
+
+const unsigned track_event_type = 9;
+const unsigned track_event_track_uuid = 11;
+const unsigned track_event_name = 23;
+
+const uint64_t track_event_type_slice_begin = 1;
+const uint64_t track_event_type_slice_end = 2;
+
+const uint64_t sequence_flags_incremental_state_cleared = 1;
+
+// trace processor requires nonzero pid
+const uint64_t trace_pid = 1;
+}
+
+void trace::write_perfetto(papki::file& fi){
+	auto threads = get_events();
+
+	proto_writer trace;
+
+	for(auto& t : threads){
+		uint64_t track_uuid = t.tid;
+		uint64_t sequence_id = t.tid;
+
+		{
+			proto_writer thread;
+			thread.write_uint(thread_descriptor_pid, trace_pid);
+			thread.write_uint(thread_descriptor_tid, t.tid);
+			thread.write_bytes(thread_descriptor_thread_name, t.name);
+
+			proto_writer track;
+			track.write_uint(track_descriptor_uuid, track_uuid);
+			track.write_bytes(track_descriptor_thread, thread.buf);
+
+			proto_writer packet;
+			packet.write_uint(trace_packet_trusted_packet_sequence_id, sequence_id);
+			packet.write_uint(trace_packet_sequence_flags, sequence_flags_incremental_state_cleared);
+			packet.write_bytes(trace_packet_track_descriptor, track.buf);
+
+			trace.write_bytes(trace_packet, packet.buf);
+		}
+
+		auto write_event = [&](uint64_t timestamp, uint64_t type, const char* name){
+			proto_writer track_event;
+			track_event.write_uint(track_event_type, type);
+			track_event.write_uint(track_event_track_uuid, track_uuid);
+			if(name){
+				track_event.write_bytes(track_event_name, name);
+			}
+
+			proto_writer packet;
+			packet.write_uint(trace_packet_timestamp, timestamp);
+			packet.write_uint(trace_packet_trusted_packet_sequence_id, sequence_id);
+			packet.write_bytes(trace_packet_track_event, track_event.buf);
+
+			trace.write_bytes(trace_packet, packet.buf);
+		};
+
+		// turn complete events into properly nested begin/end pairs, events are sorted by begin time
+		std::vector<uint64_t> end_stack;
+		for(auto& e : t.events){
+			while(!end_stack.empty() && end_stack.back() <= e.begin_ns){
+				write_event(end_stack.back(), track_event_type_slice_end, nullptr);
+				end_stack.pop_back();
+			}
+			write_event(e.begin_ns, track_event_type_slice_begin, e.name);
+			// nested event cannot end after the enclosing one
+			end_stack.push_back(end_stack.empty() ? e.end_ns : std::min(e.end_ns, end_stack.back()));
+		}
+		while(!end_stack.empty()){
+			write_event(end_stack.back(), track_event_type_slice_end, nullptr);
+			end_stack.pop_back();
+		}
+	}
+
+	write(fi, trace.buf);
+}
+
+namespace{
+// enables tracing and writes the trace on exit according to the MORDAVOKNE_TRACE environment variable
+class env_trace{
+	std::string file_name;
+public:
+	env_trace(){
+		const char* file_name = getenv("MORDAVOKNE_TRACE");
+		if(!file_name || *file_name == '\0'){
+			return;
+		}
+		this->file_name = file_name;
+
+		// construct the registry before this object, so that it is destroyed after this object
+		get_registry();
+
+		trace::set_enabled(true);
+	}
+
+	~env_trace()noexcept{
+		if(this->file_name.empty()){
+			return;
+		}
+
+		trace::set_enabled(false);
+
+		try{
+			papki::fs_file fi(this->file_name);
+			const std::string json_suffix = ".json";
+			bool is_json = this->file_name.size() >= json_suffix.size()
+					&& this->file_name.compare(this->file_name.size() - json_suffix.size(), json_suffix.size(), json_suffix) == 0;
+			if(is_json){
+				trace::write_chrome_json(fi);
+			}else{
+				trace::write_perfetto(fi);
+			}
+		}catch(std::exception& e){
+			std::cerr << "mordavokne: writing trace to " << this->file_name << " failed: " << e.what() << std::endl;
+		}
+	}
+} env_trace_instance;
+}
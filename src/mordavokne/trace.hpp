@@ -0,0 +1,131 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include <papki/file.hpp>
+
+/**
+ * @brief Tracing of main loop events.
+ * Scoped events are recorded into per-thread buffers and can be exported in Chrome JSON trace format,
+ * which is understood by chrome://tracing and https://ui.perfetto.dev, or as Perfetto protobuf trace.
+ *
+ * Main loop phases, the same as measured by frame_profiler, are recorded as events automatically.
+ * Additionally, each UI queue message execution and window resize are recorded.
+ *
+ * Tracing is disabled by default. When disabled, recording an event costs a single relaxed atomic load.
+ * If the MORDAVOKNE_TRACE environment variable is set to a file name, then tracing is enabled on program
+ * start and the trace is written to that file on program exit. If the file name ends with ".json"
+ * then Chrome JSON format is used, otherwise the Perfetto protobuf format is used.
+ *
+ * Each thread records to its own buffer without any locking. The buffer holds a limited number of events,
+ * when it is full, further events of that thread are dropped.
+ */
+namespace mordavokne{
+namespace trace{
+
+extern std::atomic<bool> enabled_flag;
+
+/**
+ * @brief Check if tracing is enabled.
+ * @return true if tracing is enabled.
+ * @return false otherwise.
+ */
+inline bool is_enabled()noexcept{
+	return enabled_flag.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Enable/disable tracing.
+ * @param enable - whether to enable (true) or disable (false) tracing.
+ */
+void set_enabled(bool enable)noexcept;
+
+/**
+ * @brief Set name of the calling thread.
+ * The name is shown by trace viewers.
+ * @param name - thread name.
+ */
+void set_thread_name(const std::string& name);
+
+/**
+ * @brief Discard recorded events.
+ * Must not be called while any thread records events, e.g. call it when tracing is disabled.
+ */
+void clear()noexcept;
+
+/**
+ * @brief Write recorded events in Chrome JSON trace format.
+ * @param fi - file to write the trace to. Must not be opened.
+ */
+void write_chrome_json(papki::file& fi);
+
+/**
+ * @brief Write recorded events in Perfetto protobuf trace format.
+ * @param fi - file to write the trace to. Must not be opened.
+ */
+void write_perfetto(papki::file& fi);
+
+// record event, called by scope, not supposed to be used directly
+void record(const char* name, uint64_t begin_ns, uint64_t end_ns)noexcept;
+
+// convert time point to trace timestamp in nanoseconds, not supposed to be used directly
+uint64_t get_timestamp_ns(std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now())noexcept;
+
+/**
+ * @brief Scoped trace event.
+ * Records an event which spans the lifetime of the scope object.
+ */
+class scope{
+	const char* name;
+	uint64_t begin_ns;
+public:
+	/**
+	 * @brief Begin event.
+	 * @param name - event name. Must be a string literal or otherwise be alive till the program exit,
+	 *               since only the pointer is stored.
+	 */
+	scope(const char* name)noexcept :
+			name(is_enabled() ? name : nullptr)
+	{
+		if(this->name){
+			this->begin_ns = get_timestamp_ns();
+		}
+	}
+
+	scope(const scope&) = delete;
+	scope& operator=(const scope&) = delete;
+
+	~scope()noexcept{
+		if(this->name){
+			record(this->name, this->begin_ns, get_timestamp_ns());
+		}
+	}
+};
+
+}
+}
@@ -196,7 +196,17 @@ public:
 		++this->fps;
 		this->rot %= morda::quaternion().set_rotation(r4::vector3<float>(1, 2, 1).normalize(), 1.5f * (float(dt) / 1000));
 		if(this->fpsSecCounter >= 1000){
-			TRACE_ALWAYS(<< "fps = " << std::dec << fps << std::endl)
+			auto& profiler = mordavokne::inst().get_frame_profiler();
+			TRACE_ALWAYS(
+					<< "fps = " << std::dec << fps
+					<< ", frame time p50/p95/p99 = " << profiler.get_percentile(50).count()
+					<< "/" << profiler.get_percentile(95).count()
+					<< "/" << profiler.get_percentile(99).count() << " us"
+					<< ", render p95 = " << profiler.get_percentile(95, mordavokne::frame_profiler::phase::render).count() << " us"
+					<< ", GPU render p95 = " << profiler.get_gpu_percentile(95).count() << " us"
+					<< std::endl
+				)
+			TRACE_ALWAYS(<< "input latency: " << mordavokne::inst().get_input_latency())
 			this->fpsSecCounter = 0;
 			this->fps = 0;
 		}
@@ -463,6 +473,10 @@ public:
 	application() :
 			mordavokne::application("morda-tests", GetWindowParams())
 	{
+		this->get_frame_profiler().set_enabled(true);
+		this->get_frame_profiler().set_gpu_timing(true);
+		this->set_input_latency_measurement(true);
+
 		this->gui.initStandardWidgets(*this->get_res_file("../../res/morda_res/"));
 
 		this->gui.context->loader.mount_res_pack(*this->get_res_file("res/"));
@@ -0,0 +1,261 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+#include <papki/fs_file.hpp>
+
+#include "../../../src/mordavokne/application.hpp"
+#include "../../../src/mordavokne/headless.hpp"
+
+#include <morda/widgets/widget.hpp>
+#include <morda/updateable.hpp>
+
+// Benchmarks of the main loop hot paths.
+// Runs on the headless backend, so no window system is needed, e.g. Mesa's llvmpipe is enough.
+// Results are printed to stdout as JSON, or written to a file if MORDAVOKNE_BENCH_OUTPUT is set.
+// The benchmarks are not run as part of the tests, run them with 'make bench'.
+
+namespace{
+// static initialization happens right after the process start, before main() is called
+const auto process_start = std::chrono::steady_clock::now();
+
+const unsigned num_events = 100000;
+const unsigned num_messages = 100000;
+const unsigned num_resizes = 1000;
+const unsigned num_frames = 300;
+
+const unsigned tree_rows = 50;
+const unsigned tree_columns = 20;
+
+const r4::vector2<unsigned> window_dims(1024, 800);
+
+struct result{
+	std::string name;
+	double value;
+	std::string unit;
+};
+
+double to_ms(std::chrono::steady_clock::duration d){
+	return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Runs the benchmarks one by one from the main loop.
+// Each benchmark is a step which posts its work and then waits for the sentinel
+// message to be handled, which means all the work posted before it is done.
+class runner : public morda::updateable{
+	mordavokne::application& app;
+
+	std::vector<std::function<void()>> steps;
+	size_t cur_step = 0;
+
+	// set when current step has posted its work and waits for it to complete
+	bool waiting = false;
+
+	std::chrono::steady_clock::time_point step_start;
+
+	uint64_t frames_start = 0;
+
+	void post_sentinel(std::function<void()>&& done){
+		this->waiting = true;
+		this->app.gui.context->run_from_ui_thread([this, done = std::move(done)](){
+			done();
+			this->waiting = false;
+			++this->cur_step;
+		});
+	}
+
+	void add(std::string name, double value, std::string unit){
+		this->results.push_back(result{std::move(name), value, std::move(unit)});
+	}
+
+	void step_startup(){
+		if(this->app.get_frame_statistics().num_rendered == 0){
+			return;
+		}
+		this->add("startup_to_first_frame", to_ms(std::chrono::steady_clock::now() - process_start), "ms");
+		++this->cur_step;
+	}
+
+	void step_ui_queue(){
+		this->step_start = std::chrono::steady_clock::now();
+		for(unsigned i = 0; i != num_messages; ++i){
+			this->app.gui.context->run_from_ui_thread([](){});
+		}
+		this->post_sentinel([this](){
+			auto ms = to_ms(std::chrono::steady_clock::now() - this->step_start);
+			this->add("ui_queue_post_drain", double(num_messages) * 1000 / ms, "msg/s");
+		});
+	}
+
+	void step_event_dispatch(){
+		this->step_start = std::chrono::steady_clock::now();
+		for(unsigned i = 0; i != num_events; ++i){
+			mordavokne::headless::inject_mouse_move(r4::vector2<float>(float(i % window_dims.x()), float(i % window_dims.y())));
+		}
+		this->post_sentinel([this](){
+			auto ms = to_ms(std::chrono::steady_clock::now() - this->step_start);
+			this->add("event_dispatch_mouse_move", double(num_events) * 1000 / ms, "event/s");
+		});
+	}
+
+	void step_load_tree(){
+		// generate the widget tree description
+		papki::fs_file fi(this->app.storage_dir + "bench_tree.gui");
+		{
+			std::stringstream ss;
+			ss << "@column{" << std::endl;
+			for(unsigned r = 0; r != tree_rows; ++r){
+				ss << "\t@row{" << std::endl;
+				for(unsigned c = 0; c != tree_columns; ++c){
+					ss << "\t\t@push_button{ @text{ text{\"" << r << ":" << c << "\"} } }" << std::endl;
+				}
+				ss << "\t}" << std::endl;
+			}
+			ss << "}" << std::endl;
+
+			auto str = ss.str();
+			fi.open(papki::file::mode::create);
+			utki::scope_exit scope_exit([&fi](){
+				fi.close();
+			});
+			fi.write(utki::make_span(reinterpret_cast<const uint8_t*>(str.data()), str.size()));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		this->app.gui.set_root(this->app.gui.context->inflater.inflate(fi));
+		this->add("large_tree_inflate", to_ms(std::chrono::steady_clock::now() - start), "ms");
+
+		auto& prof = this->app.get_frame_profiler();
+		prof.set_capacity(num_frames);
+		prof.clear();
+		prof.set_enabled(true);
+
+		this->frames_start = this->app.get_frame_statistics().num_rendered;
+		++this->cur_step;
+	}
+
+	void step_frame_time(){
+		// the main loop renders a frame every cycle while this updateable is running
+		if(this->app.get_frame_statistics().num_rendered - this->frames_start < num_frames){
+			return;
+		}
+
+		auto& prof = this->app.get_frame_profiler();
+		prof.set_enabled(false);
+
+		auto us_to_ms = [](std::chrono::microseconds us){
+			return double(us.count()) / 1000;
+		};
+		this->add("large_tree_frame_time_p50", us_to_ms(prof.get_percentile(50)), "ms");
+		this->add("large_tree_frame_time_p95", us_to_ms(prof.get_percentile(95)), "ms");
+		this->add("large_tree_frame_time_p99", us_to_ms(prof.get_percentile(99)), "ms");
+		this->add(
+				"large_tree_render_time_p50",
+				us_to_ms(prof.get_percentile(50, mordavokne::frame_profiler::phase::render)),
+				"ms"
+			);
+		++this->cur_step;
+	}
+
+	void step_resize_storm(){
+		this->step_start = std::chrono::steady_clock::now();
+		for(unsigned i = 0; i != num_resizes; ++i){
+			mordavokne::headless::inject_resize(
+					i % 2 == 0 ? window_dims / 2 : window_dims
+				);
+		}
+		mordavokne::headless::inject_resize(window_dims);
+		this->post_sentinel([this](){
+			auto ms = to_ms(std::chrono::steady_clock::now() - this->step_start);
+			this->add("resize_storm", ms * 1000 / double(num_resizes + 1), "us/resize");
+		});
+	}
+
+public:
+	std::vector<result> results;
+
+	std::function<void()> finished_handler;
+
+	runner(mordavokne::application& app) :
+			app(app)
+	{
+		this->steps = {
+			[this](){this->step_startup();},
+			[this](){this->step_ui_queue();},
+			[this](){this->step_event_dispatch();},
+			[this](){this->step_load_tree();},
+			[this](){this->step_frame_time();},
+			[this](){this->step_resize_storm();}
+		};
+	}
+
+	void update(uint32_t dt)override{
+		if(this->waiting){
+			return;
+		}
+
+		if(this->cur_step == this->steps.size()){
+			this->app.gui.context->updater->stop(*this);
+			if(this->finished_handler){
+				this->finished_handler();
+			}
+			return;
+		}
+
+		this->steps[this->cur_step]();
+	}
+};
+
+void write_results(std::ostream& o, const std::vector<result>& results){
+	o << "{\"benchmarks\":[";
+	for(auto i = results.begin(); i != results.end(); ++i){
+		if(i != results.begin()){
+			o << ",";
+		}
+		o << std::endl << "{\"name\":\"" << i->name << "\",\"value\":" << std::setprecision(6) << i->value << ",\"unit\":\"" << i->unit << "\"}";
+	}
+	o << std::endl << "]}" << std::endl;
+}
+}
+
+class application : public mordavokne::application{
+	std::shared_ptr<runner> bench_runner;
+
+public:
+	application() :
+			mordavokne::application("mordavokne-bench", mordavokne::window_params(window_dims))
+	{
+		this->gui.initStandardWidgets(*this->get_res_file("../../res/morda_res/"));
+
+		this->bench_runner = std::make_shared<runner>(*this);
+
+		this->bench_runner->finished_handler = [this](){
+			if(const char* out = std::getenv("MORDAVOKNE_BENCH_OUTPUT")){
+				std::stringstream ss;
+				write_results(ss, this->bench_runner->results);
+				auto str = ss.str();
+
+				papki::fs_file fi(out);
+				fi.open(papki::file::mode::create);
+				utki::scope_exit scope_exit([&fi](){
+					fi.close();
+				});
+				fi.write(utki::make_span(reinterpret_cast<const uint8_t*>(str.data()), str.size()));
+			}else{
+				write_results(std::cout, this->bench_runner->results);
+			}
+			this->quit();
+		};
+
+		// update every main loop cycle
+		this->gui.context->updater->start(this->bench_runner, 0);
+	}
+};
+
+mordavokne::application_factory app_factory([](auto args){
+	return std::make_unique<::application>();
+});
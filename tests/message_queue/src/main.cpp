@@ -0,0 +1,88 @@
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <functional>
+
+#include <poll.h>
+
+#include "../../../src/mordavokne/glue/message_queue.hxx"
+
+// Multi-producer stress test of the UI message queue.
+// Many producers post numbered messages into a small ring buffer, so that the overflow queue is used a lot,
+// and the consumer checks that the messages of each producer are executed in the order they were posted.
+// Build with 'config=tsan' to check for data races.
+
+namespace{
+const unsigned num_producers = 8;
+const unsigned num_messages_per_producer = 100000;
+const size_t ring_capacity = 4;
+}
+
+int main(int argc, char** argv){
+	mordavokne::message_queue queue(ring_capacity);
+
+	// only accessed from the consumer thread, i.e. from the messages
+	std::vector<unsigned> num_executed(num_producers, 0);
+	unsigned num_out_of_order = 0;
+
+	std::vector<std::thread> producers;
+	for(unsigned p = 0; p != num_producers; ++p){
+		producers.emplace_back([&, p](){
+			for(unsigned i = 0; i != num_messages_per_producer; ++i){
+				auto check = [&num_executed, &num_out_of_order, p, i](){
+					if(num_executed[p] != i){
+						++num_out_of_order;
+					}
+					num_executed[p] = i + 1;
+				};
+
+				// alternate between messages stored within the cell and the ones allocated on the heap
+				if(i % 2 == 0){
+					queue.push_back(check);
+				}else{
+					std::array<uint8_t, mordavokne::message::buffer_size * 2> padding{};
+					queue.push_back([check, padding](){
+						check();
+					});
+				}
+			}
+		});
+	}
+
+	const size_t num_messages = size_t(num_producers) * num_messages_per_producer;
+
+	size_t num_drained = 0;
+	while(num_drained != num_messages){
+		pollfd pfd = {queue.get_handle(), POLLIN, 0};
+		if(poll(&pfd, 1, 10000) == 0){
+			std::cout << "timed out waiting for messages, " << num_drained << " of " << num_messages << " executed" << std::endl;
+			return 1;
+		}
+
+		num_drained += queue.drain([](mordavokne::message& m){
+			m();
+		});
+	}
+
+	for(auto& t : producers){
+		t.join();
+	}
+
+	for(unsigned p = 0; p != num_producers; ++p){
+		if(num_executed[p] != num_messages_per_producer){
+			std::cout << "producer " << p << ": " << num_executed[p] << " messages executed, expected " << num_messages_per_producer << std::endl;
+			return 1;
+		}
+	}
+
+	if(num_out_of_order != 0){
+		std::cout << num_out_of_order << " messages executed out of order" << std::endl;
+		return 1;
+	}
+
+	std::cout << "message queue: " << num_messages << " messages from " << num_producers << " producers executed in order" << std::endl;
+
+	return 0;
+}
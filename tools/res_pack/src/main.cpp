@@ -0,0 +1,70 @@
+/*
+mordavokne - morda GUI adaptation layer
+
+Copyright (C) 2016-2021  Ivan Gagis <igagis@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../../src/mordavokne/res_pack.hpp"
+
+// Resource pack builder.
+// Packs all files of the given directories into a single resource pack file, which can then be
+// mounted with mordavokne::application::mount_res_pack() or via MORDAVOKNE_RES_PACK environment variable.
+// The directories are to be given the same way as the application passes them to get_res_file(),
+// so the tool is to be run from the same working directory the application runs from.
+// With --lz4 option each file is compressed separately, unless it does not compress well.
+
+int main(int argc, const char** argv){
+	auto compression = mordavokne::res_pack::compression::none;
+
+	int first_arg = 1;
+	if(argc > 1 && std::string(argv[1]) == "--lz4"){
+		compression = mordavokne::res_pack::compression::lz4;
+		++first_arg;
+	}
+
+	if(argc - first_arg < 2){
+		std::cerr << "usage: " << argv[0] << " [--lz4] <output pack file> <resource dir>/ [<resource dir>/ ...]" << std::endl;
+		return 1;
+	}
+
+	const char* pack_file_name = argv[first_arg];
+
+	std::vector<std::string> dirs;
+	for(int i = first_arg + 1; i != argc; ++i){
+		std::string d = argv[i];
+		if(!d.empty() && d.back() != '/'){
+			d.push_back('/');
+		}
+		dirs.push_back(std::move(d));
+	}
+
+	try{
+		auto num_files = mordavokne::res_pack::write(pack_file_name, dirs, compression);
+		std::cout << "packed " << num_files << " files to " << pack_file_name << std::endl;
+	}catch(std::exception& e){
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}